@@ -0,0 +1,80 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/* Bulk-synchronous phases, as in splash2, NPB or parsec: every thread
+   does some work and then waits at a barrier, P times. Run it with
+   bench-barrier-engine to compare the pthread-based barrier path with
+   barrier_engine. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+#include "tern/user.h"
+
+#define MAX (100)
+
+int T; // number of threads
+int C; // computation size of a phase
+int P; // number of phases
+
+pthread_t th[MAX];
+pthread_barrier_t ba;
+
+long compute(int C, long x) {
+  for(int i=0;i<C;++i)
+    x = x * 31 + i;
+  return x;
+}
+
+void* thread_func(void* arg) {
+  long sum = (long)arg;
+  for(int i=0; i<P; ++i) {
+    sum = compute(C, sum);
+    pthread_barrier_wait(&ba);
+  }
+  return (void*)sum;
+}
+
+extern "C" int main(int argc, char * argv[]);
+int main(int argc, char *argv[]) {
+  int ret;
+  struct timeval start, end;
+
+  assert(argc == 4);
+  T = atoi(argv[1]); assert(T <= MAX);
+  C = atoi(argv[2]);
+  P = atoi(argv[3]);
+
+  pthread_barrier_init(&ba, NULL, T);
+  gettimeofday(&start, NULL);
+  for(long i=0; i<T; ++i) {
+    ret  = pthread_create(&th[i], NULL, thread_func, (void*)i);
+    assert(!ret && "pthread_create() failed!");
+  }
+  for(int i=0; i<T; ++i)
+    pthread_join(th[i], NULL);
+  gettimeofday(&end, NULL);
+  pthread_barrier_destroy(&ba);
+
+  double usec = (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_usec - start.tv_usec);
+  printf("threads %d, phases %d, time %.3f sec, %.1f us/phase\n",
+    T, P, usec / 1e6, usec / P);
+  return 0;
+}
@@ -54,15 +54,18 @@ void* thread_func(void* arg) {
 
     compute(C);
   }
+  return NULL;
 }
 
 extern "C" int main(int argc, char * argv[]);
 int main(int argc, char *argv[]) {
   int ret;
 
-  assert(argc == 3);
+  assert(argc == 3 || argc == 4);
   T = atoi(argv[1]); assert(T <= MAX);
   C = atoi(argv[2]);
+  if(argc == 4)
+    I = atoi(argv[3]);
 
   for(long i=0; i<T; ++i) {
     pthread_mutex_init(&mu[i], NULL);
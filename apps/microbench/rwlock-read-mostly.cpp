@@ -0,0 +1,91 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* A read-mostly rwlock, as in a cache or directory server: every thread
+   takes the read lock, does some work while holding it, and takes the
+   write lock once every W operations. Run it with bench-rwlock-engine to
+   compare the pthread-based rwlock path with rwlock_engine. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+#include "tern/user.h"
+
+#define MAX (100)
+
+int T; // number of threads
+int C; // computation size inside the read lock
+int I; // number of lock/unlock pairs per thread
+int W; // one write lock every W operations
+
+pthread_t th[MAX];
+pthread_rwlock_t rw = PTHREAD_RWLOCK_INITIALIZER;
+volatile long data;
+
+long compute(int C) {
+  long x = data;
+  for(int i=0;i<C;++i)
+    x = x * 31 + i;
+  return x;
+}
+
+void* thread_func(void* arg) {
+  long sum = 0;
+  for(int i=0; i<I; ++i) {
+    if (i % W == 0) {
+      pthread_rwlock_wrlock(&rw);
+      data++;
+      pthread_rwlock_unlock(&rw);
+    } else {
+      pthread_rwlock_rdlock(&rw);
+      sum += compute(C);
+      pthread_rwlock_unlock(&rw);
+    }
+  }
+  return (void*)sum;
+}
+
+extern "C" int main(int argc, char * argv[]);
+int main(int argc, char *argv[]) {
+  int ret;
+  struct timeval start, end;
+
+  assert(argc == 5);
+  T = atoi(argv[1]); assert(T <= MAX);
+  C = atoi(argv[2]);
+  I = atoi(argv[3]);
+  W = atoi(argv[4]); assert(W > 0);
+
+  gettimeofday(&start, NULL);
+  for(long i=0; i<T; ++i) {
+    ret  = pthread_create(&th[i], NULL, thread_func, (void*)i);
+    assert(!ret && "pthread_create() failed!");
+  }
+  for(int i=0; i<T; ++i)
+    pthread_join(th[i], NULL);
+  gettimeofday(&end, NULL);
+
+  double usec = (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_usec - start.tv_usec);
+  long nops = 2L * T * I;
+  printf("threads %d, ops %ld, writes %ld, time %.3f sec, %.1f ns/op\n",
+    T, nops, data, usec / 1e6, usec * 1e3 / nops);
+  return 0;
+}
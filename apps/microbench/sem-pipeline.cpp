@@ -0,0 +1,93 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/* A bounded producer/consumer queue guarded by two counting semaphores,
+   as in pbzip2 or pfscan: T producers each hand I items through a buffer
+   of B slots to T consumers. Run it with bench-sem-engine to compare the
+   sem_trywait-based semaphore path with sem_engine. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "tern/user.h"
+
+#define MAX (100)
+
+int T; // number of producers, and of consumers
+int I; // number of items per producer
+int B; // number of buffer slots
+
+pthread_t th[2*MAX];
+sem_t slots, items;
+long *buf;
+volatile unsigned head, tail;
+volatile long total;
+
+void* producer(void* arg) {
+  for(int i=0; i<I; ++i) {
+    sem_wait(&slots);
+    buf[__sync_fetch_and_add(&tail, 1) % B] = i;
+    sem_post(&items);
+  }
+  return NULL;
+}
+
+void* consumer(void* arg) {
+  long sum = 0;
+  for(int i=0; i<I; ++i) {
+    sem_wait(&items);
+    sum += buf[__sync_fetch_and_add(&head, 1) % B];
+    sem_post(&slots);
+  }
+  __sync_fetch_and_add(&total, sum);
+  return NULL;
+}
+
+extern "C" int main(int argc, char * argv[]);
+int main(int argc, char *argv[]) {
+  int ret;
+  struct timeval start, end;
+
+  assert(argc == 4);
+  T = atoi(argv[1]); assert(T <= MAX);
+  I = atoi(argv[2]);
+  B = atoi(argv[3]); assert(B > 0);
+  buf = new long[B];
+  sem_init(&slots, 0, B);
+  sem_init(&items, 0, 0);
+
+  gettimeofday(&start, NULL);
+  for(long i=0; i<T; ++i) {
+    ret  = pthread_create(&th[2*i], NULL, producer, NULL);
+    assert(!ret && "pthread_create() failed!");
+    ret  = pthread_create(&th[2*i+1], NULL, consumer, NULL);
+    assert(!ret && "pthread_create() failed!");
+  }
+  for(int i=0; i<2*T; ++i)
+    pthread_join(th[i], NULL);
+  gettimeofday(&end, NULL);
+
+  double usec = (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_usec - start.tv_usec);
+  long nitems = (long)T * I;
+  printf("threads %d, items %ld, sum %ld, time %.3f sec, %.1f ns/item\n",
+    2*T, nitems, total, usec / 1e6, usec * 1e3 / nitems);
+  return 0;
+}
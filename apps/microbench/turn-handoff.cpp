@@ -0,0 +1,80 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Measures the cost of passing the turn between threads: each thread
+   locks and unlocks its own mutex, so under the RR scheduler every
+   operation is one putTurn() -> getTurn() handoff and nothing else.
+   Run it with bench-turn-types to compare the enforce_turn_type relays.
+   The optional third argument adds that many loop iterations of work
+   while holding the mutex, long enough for the next threads to stop
+   spinning and sleep; bench-prewake uses it. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+#include "tern/user.h"
+
+#define MAX (100)
+
+int T; // number of threads
+int I; // number of lock/unlock pairs per thread
+int W; // loop iterations of work while holding the mutex
+
+pthread_t th[MAX];
+pthread_mutex_t mu[MAX];
+
+void* thread_func(void* arg) {
+  long tid = (long)arg;
+  for(int i=0; i<I; ++i) {
+    pthread_mutex_lock(&mu[tid]);
+    for(volatile int w=0; w<W; ++w)
+      ;
+    pthread_mutex_unlock(&mu[tid]);
+  }
+  return NULL;
+}
+
+extern "C" int main(int argc, char * argv[]);
+int main(int argc, char *argv[]) {
+  int ret;
+  struct timeval start, end;
+
+  assert(argc == 3 || argc == 4);
+  T = atoi(argv[1]); assert(T <= MAX);
+  I = atoi(argv[2]);
+  W = argc == 4 ? atoi(argv[3]) : 0;
+
+  gettimeofday(&start, NULL);
+  for(long i=0; i<T; ++i) {
+    pthread_mutex_init(&mu[i], NULL);
+    ret  = pthread_create(&th[i], NULL, thread_func, (void*)i);
+    assert(!ret && "pthread_create() failed!");
+  }
+  for(int i=0; i<T; ++i)
+    pthread_join(th[i], NULL);
+  gettimeofday(&end, NULL);
+
+  double usec = (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_usec - start.tv_usec);
+  long nops = 2L * T * I;
+  printf("threads %d, ops %ld, time %.3f sec, %.1f ns/op\n",
+    T, nops, usec / 1e6, usec * 1e3 / nops);
+  return 0;
+}
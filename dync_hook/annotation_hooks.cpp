@@ -130,6 +130,29 @@ extern "C" void tern_detach(){
 }
 #endif
 
+#ifndef __SPEC_HOOK_tern_set_domain
+extern "C" void tern_set_domain(int domain){
+#ifdef __USE_TERN_RUNTIME
+  if (Space::isApp() && options::DMT && options::enforce_annotations) {
+    tern_set_domain_real(domain);
+  }
+#endif
+  // If not runnning with xtern, NOP.
+}
+#endif
+
+#ifndef __SPEC_HOOK_backedge_stat
+extern "C" int backedge_stat(int id){
+#ifdef __USE_TERN_RUNTIME
+  if (Space::isApp() && options::DMT) {
+    tern_backedge_stat_real(id);
+  }
+#endif
+  // If not runnning with xtern, NOP.
+  return 0;
+}
+#endif
+
 #ifndef __SPEC_HOOK_tern_non_det_barrier_end
 extern "C" void pcs_barrier_exit(int bar_id, int cnt){
 #ifdef __USE_TERN_RUNTIME
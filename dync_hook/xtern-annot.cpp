@@ -64,6 +64,14 @@ void tern_detach() {
   //fprintf(stderr, "Non-deterministic tern_detach\n");
 }
 
+void tern_set_domain(int domain) {
+  //fprintf(stderr, "Non-deterministic tern_set_domain\n");
+}
+
+int backedge_stat(int id) {
+  return 0;
+}
+
 void pcs_barrier_exit(int bar_id, int cnt) {
   //fprintf(stderr, "Non-deterministic pcs_barrier_exit\n");
 }
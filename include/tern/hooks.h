@@ -54,6 +54,8 @@ extern "C" {
   void tern_detach_real();
   void tern_non_det_barrier_end_real(int bar_id, int cnt);
   void tern_set_base_time_real(struct timespec *ts);
+  void tern_set_domain_real(int domain);
+  void tern_backedge_stat_real(int id);
 
   /// hooks tern automatically inserts.  start with the ones tern provides
   void tern_prog_begin(void);   /// initializes tern internal data
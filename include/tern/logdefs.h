@@ -201,14 +201,21 @@ inline short ExtraArgsRec::numArgsInRec() const {
   return std::min(rec_narg, (short)MAX_EXTRA_ARGS);
 }
 
+/// @gen is the generation of a recycled @tid, so that the threads sharing
+/// a tid over time each get their own log
 static inline int getLogFilename(char *buf, size_t sz,
-                                 int tid, const char* ext) {
+                                 int tid, const char* ext, int gen = 0) {
+  char tidstr[32];
+  if (gen > 0)
+    snprintf(tidstr, sizeof(tidstr), "%d.%d", tid, gen);
+  else
+    snprintf(tidstr, sizeof(tidstr), "%d", tid);
   if (options::pid_in_logfilename)
-    return snprintf(buf, sz, "%s/tid-%d-%d%s",
-                  options::output_dir.c_str(), getpid(), tid, ext);
+    return snprintf(buf, sz, "%s/tid-%d-%s%s",
+                  options::output_dir.c_str(), getpid(), tidstr, ext);
   else
-    return snprintf(buf, sz, "%s/tid-%d%s",
-                  options::output_dir.c_str(), tid, ext);
+    return snprintf(buf, sz, "%s/tid-%s%s",
+                  options::output_dir.c_str(), tidstr, ext);
 }
 
 } // namespace tern
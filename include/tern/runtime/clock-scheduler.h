@@ -0,0 +1,90 @@
+/* Copyright (c) 2013,  Regents of the Columbia University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __TERN_CLOCK_SCHEDULER_H
+#define __TERN_CLOCK_SCHEDULER_H
+
+#include "tern/runtime/record-scheduler.h"
+
+namespace tern {
+
+/** Kendo-style scheduling with deterministic logical clocks
+(options::clock_scheduler).
+
+Each thread has a logical clock that only counts its own progress: one
+tick per sync operation, and one per loop back-edge the program reports
+(advanceClock(), through backedge_stat(); see eval/find-hotspot). The turn
+is not passed around @runq; a thread asking for it gets it once no other
+thread on @runq has a smaller (clock, tid). The clock of a thread asking
+for the turn stays put, and the clocks of the others only grow, so which
+thread gets each turn does not depend on timing, and a thread computing
+between two sync operations only holds up the threads whose clocks are
+ahead of its own.
+
+@runq holds the threads that count (those not waiting in @waitq or in a
+blocking call), in no particular order; the turn holder moves itself to
+its front so that the inherited RRScheduler methods (wait(), signal(),
+...) work unchanged. A thread coming back to @runq starts from the clock
+of the thread that woke it up, or of the last turn, if its own is behind.
+
+Waiting threads sleep on their wait_t until the turn holder that puts them
+back on @runq posts it; threads asking for the turn poll. **/
+struct ClockScheduler: public RRScheduler {
+  typedef RRScheduler Parent;
+
+  virtual void getTurn();
+  virtual void putTurn(bool at_thread_end = false);
+  virtual void advanceClock(unsigned n);
+
+  virtual int block();
+  virtual bool interProStart();
+  virtual bool interProEnd();
+
+  void childForkReturn();
+
+  /// also starts the clock of the new thread from its creator's
+  void create(pthread_t new_th);
+
+  ClockScheduler();
+  ~ClockScheduler();
+
+protected:
+  enum {ACTIVE, WAITING, BLOCKED};
+
+  struct thd_clock_t {
+    volatile unsigned long long clock;
+    int state;        // ACTIVE (on @runq), WAITING (on @waitq) or BLOCKED
+    bool must_sleep;  // wait for the post of the thread that wakes it up
+  }__attribute__((aligned(64)));  // read by all threads asking for the turn
+
+  slot_table<thd_clock_t> clocks;
+  /// tid of the turn holder, or InvalidTid
+  volatile int holder;
+  /// clock of the latest turn holder, for threads back from blocking calls
+  unsigned long long clock_floor;
+
+  /// whether @tid has the smallest (clock, tid) on @runq
+  bool isMin(int tid);
+  /// give @runq's new threads their clocks and post the waiting ones
+  void activate(unsigned long long waker_clock);
+  virtual void next(bool at_thread_end = false, bool hasPoppedFront = false);
+};
+
+} // namespace tern
+
+#endif
@@ -68,7 +68,8 @@ struct Logger {
   /// code and data shared by all loggers
   static void progBegin();
   static void progEnd();
-  static void threadBegin(int tid);
+  /// @gen: generation of a recycled @tid (see TidMap::generation())
+  static void threadBegin(int tid, int gen = 0);
   static void threadEnd(void);
 
   /// map function address at runtime to a unique function ID.  We need
@@ -90,7 +91,7 @@ struct TxtLogger: public Logger {
                        timespec time1, 
                        timespec time2, timespec sched_time, 
                        bool after = true, ...);
-  TxtLogger(int tid);
+  TxtLogger(int tid, int gen = 0);
   virtual ~TxtLogger();
 
 protected:
@@ -114,7 +115,7 @@ struct BinLogger: public Logger {
                        timespec time2, timespec sched_time, 
                        bool after = true, ...);
   virtual ~BinLogger();
-  BinLogger(int tid);
+  BinLogger(int tid, int gen = 0);
 
 protected:
 
@@ -141,7 +142,7 @@ struct TestLogger: public Logger {
                        timespec time2, timespec sched_time, 
                        bool after = true, ...);
   virtual void flush();
-  TestLogger(int tid);
+  TestLogger(int tid, int gen = 0);
   virtual ~TestLogger();
 
 protected:
@@ -23,6 +23,7 @@
 #define __TERN_RECORDER_RUNTIME_H
 
 #include <tr1/unordered_map>
+#include <boost/static_assert.hpp>
 #include "tern/runtime/runtime.h"
 #include "tern/runtime/record-scheduler.h"
 #include "runtime-stat.h"
@@ -30,29 +31,37 @@
 
 namespace tern {
 
-struct barrier_t {
-  int count;    // barrier count
-  int narrived; // number of threads arrived at the barrier
+/// what the barrier engine (options::barrier_engine) stores in a
+/// pthread_barrier_t it owns: the barrier's record in the sync table
+struct det_barrier_ref_t {
+  enum {MAGIC = 0x78626172};
+  unsigned magic;
+  sync_obj_t *obj;
 };
-struct ref_cnt_barrier_t {
-  unsigned count;    // barrier count
-  unsigned nactive;  // number of threads in the linup region (between lineup_starnt and lineup_end).
-  unsigned timeout;  // Number of turns that an operation (at most) has to block.
-  enum PHASE {ARRIVING, LEAVING}; // ARRIVING: we have to wait up to "count" threads arrive or timeout.
-                              // LEAVING: timeout has happened or all threads have arrived.
-  PHASE phase;
-  long nSuccess;
-  long nTimeout;
-  ref_cnt_barrier_t() {
-    nSuccess = nTimeout = 0;
-  }
-  void setArriving() {phase = ARRIVING;}
-  void setLeaving() {phase = LEAVING;}
-  bool isArriving() {return phase == ARRIVING;}
-  bool isLeaving() {return phase == LEAVING;}
+BOOST_STATIC_ASSERT(sizeof(det_barrier_ref_t) <= sizeof(pthread_barrier_t));
+
+/// the thread-private sync objects of one thread (options::private_sync_fast_path)
+struct private_syncs_t {
+  /// objects only this thread has touched, with their mutex engine state
+  /// in the sync table (NULL without the engine); read by the owner
+  /// without turn
+  std::tr1::unordered_map<void*, det_mutex_t*> objs;
+  /// objects in @objs other threads have touched since, to be shared at
+  /// the owner's next turn
+  std::vector<void*> requests;
 };
-typedef std::tr1::unordered_map<pthread_barrier_t*, barrier_t> barrier_map;
-typedef std::tr1::unordered_map<unsigned, ref_cnt_barrier_t> refcnt_bar_map;
+/// a sync operation a thread ran without the turn (options::turn_free_init),
+/// to be caught up with at the thread's next turn
+struct deferred_sync_t {
+  unsigned ins;
+  unsigned short op;  // syncfunc::pthread_mutex_init, ...
+  void *obj;
+  int ret;
+  uint64_t arg;       // the attr of pthread_rwlock_init, the value of sem_init, or
+                      // whether the mutex of pthread_mutex_init stayed private
+  timespec app_time;
+};
+enum {MAX_DEFERRED_SYNCS = 16};
 
 typedef std::tr1::unordered_map<pthread_t, int> tid_map_t;
 typedef std::tr1::unordered_map<void*, std::list<int> > waiting_tid_t;
@@ -97,10 +106,12 @@ struct RecorderRT: public Runtime, public _Scheduler {
 
   // semaphore
   int semInit(unsigned insid, int &error, sem_t *sem, int pshared, unsigned int value);
+  int semDestroy(unsigned insid, int &error, sem_t *sem);
   int semWait(unsigned insid, int &error, sem_t *sem);
   int semTryWait(unsigned insid, int &error, sem_t *sem);
   int semTimedWait(unsigned insid, int &error, sem_t *sem, const struct timespec *abstime);
   int semPost(unsigned insid, int &error, sem_t *sem);
+  int semGetValue(unsigned insid, int &error, sem_t *sem, int *sval);
 
   // new programming primitives
   void lineupInit(long opaque_type, unsigned count, unsigned timeout_turns);
@@ -112,6 +123,9 @@ struct RecorderRT: public Runtime, public _Scheduler {
   void threadDetach();
   void nonDetBarrierEnd(int bar_id, int cnt);
   void setBaseTime(struct timespec *ts);
+  void setDomain(int domain);
+  bool backEdge(int id);
+  void preempt(int id);
   
   void symbolic(unsigned insid, int &error, void *addr, int nbytes, const char *name);
 
@@ -178,16 +192,21 @@ struct RecorderRT: public Runtime, public _Scheduler {
   int __pthread_rwlock_unlock(unsigned ins, int &error, pthread_rwlock_t *rwlock);
   int __pthread_rwlock_destroy(unsigned ins, int &error, pthread_rwlock_t *rwlock);
   int __pthread_rwlock_init(unsigned ins, int &error, pthread_rwlock_t *rwlock, const pthread_rwlockattr_t * attr);
+  int __pthread_rwlock_timedrdlock(unsigned ins, int &error, pthread_rwlock_t *rwlock, const struct timespec *abstime);
+  int __pthread_rwlock_timedwrlock(unsigned ins, int &error, pthread_rwlock_t *rwlock, const struct timespec *abstime);
 
   // print stat.
   void printStat();
 
   RecorderRT(): _Scheduler() {
     int ret;
+    nPrivateSyncRequests = 0;
     ret = sem_init(&thread_begin_sem, 0, 0);
     assert(!ret && "can't initialize semaphore!");
     ret = sem_init(&thread_begin_done_sem, 0, 0);
     assert(!ret && "can't initialize semaphore!");
+    // keep the records of plain channels too, for printSyncObjStat()
+    _Scheduler::syncObjects().keep_unused(options::record_runtime_stat);
   }
 
   ~RecorderRT() {
@@ -199,20 +218,127 @@ protected:
   These two operations should only involve "sync" objects from applications or soft barrier hints. */
   int syncWait(void *chan, unsigned timeout = Scheduler::FOREVER);
   void syncSignal(void *chan, bool all=false);
+  int syncSignalFirst(void *chan);
+  int syncWaitList(wait_queue::list_t &l, unsigned timeout = Scheduler::FOREVER);
+  void syncSignalList(wait_queue::list_t &l);
+
+  /// the record of sync object @addr in the sync table the runtime shares
+  /// with the wait queues (see sync-table.h), created with kind NONE if
+  /// there is none. The caller sets up the state of a record whose kind is
+  /// not the one it expects: the address was unused or its object is gone.
+  /// All must be called with turn held
+  sync_obj_t *syncObj(void *addr) {
+    return _Scheduler::syncObjects().find_or_create(addr);
+  }
+  /// the record of @addr if it holds the state of a @kind object, else NULL
+  sync_obj_t *findSyncObj(void *addr, sync_obj_t::KIND kind) {
+    sync_obj_t *obj = _Scheduler::syncObjects().find(addr);
+    return obj && obj->kind == kind ? obj : NULL;
+  }
+  /// forget the state of @obj; the record goes once nobody waits on it
+  void dropSyncObj(sync_obj_t *obj) {
+    obj->kind = sync_obj_t::NONE;
+    _Scheduler::syncObjects().release(obj);
+  }
+  /// print the sync objects threads waited on most (record_runtime_stat)
+  void printSyncObjStat();
 
   int absTimeToTurn(const struct timespec *abstime);
   int relTimeToTurn(const struct timespec *reltime);
 
   int pthreadMutexLockHelper(pthread_mutex_t *mutex, unsigned timeout = Scheduler::FOREVER);
+  /// wake up the waiters of @cv; with cond_wait_morphing, if their mutex is
+  /// held, move them to wait on the mutex instead
+  void condSignalHelper(pthread_cond_t *cv, bool all);
+  /// release @mu before waiting on a cond var, and get it back afterwards
+  void condUnlockHelper(pthread_mutex_t *mu);
+  void condRelockHelper(pthread_mutex_t *mu);
+  /// the record of @cv, set up for a waiter passing @mu, and its release
+  /// once the waiter is back
+  sync_obj_t *condWaitHelper(pthread_cond_t *cv, pthread_mutex_t *mu);
+  void condWaitEndHelper(pthread_cond_t *cv);
+
+  /// the mutex engine: lock ownership lives in the mutex's record and unlock
+  /// hands the mutex to the first waiter. All must be called with turn held
+  /// and return what the pthread function would.
+  bool useMutexEngine(pthread_mutex_t *mu);
+  det_mutex_t &detMutex(pthread_mutex_t *mu);
+  void detMutexReset(det_mutex_t &m, pthread_mutex_t *mu);
+  int detMutexLock(pthread_mutex_t *mu, unsigned timeout);
+  int detMutexTryLock(pthread_mutex_t *mu);
+  int detMutexTake(det_mutex_t &m);
+  int detMutexRelease(det_mutex_t &m);
+  int detMutexUnlock(pthread_mutex_t *mu);
+
+  /// thread-private sync objects. The first thread touching an object owns
+  /// it, and its lock operations skip the turn (privateMutexOp()). The
+  /// first time another thread touches the object, with turn held, the
+  /// object becomes shared for good: at once if the owner is in wait(),
+  /// else at the owner's next turn, until which the other thread waits.
+  /// Either way the switch happens at the same point of the schedule in
+  /// every run. An owner about to block in a system call shares all its
+  /// objects first (sharePrivateSyncs()), since it cannot hand them over
+  /// while it blocks. All but privateMutexOp() and sharePrivateSyncs()
+  /// must be called with turn held.
+  enum {PRIVATE_LOCK, PRIVATE_TRYLOCK, PRIVATE_UNLOCK};
+  bool privateMutexOp(unsigned ins, int &error, pthread_mutex_t *mu, int op, int &ret);
+  void privateSyncTouch(void *obj, bool privatize);
+  void privateSyncForget(void *obj);
+  void promotePrivateSync(sync_obj_t *obj);
+  void promoteRequestedSyncs();
+  void promoteAllPrivateSyncs();
+  void sharePrivateSyncs();
+  void resetPrivateSyncs();
+
+  /// turn-free init/destroy. turnFreeSync() tells whether the calling
+  /// thread may run one more operation without the turn; deferSync()
+  /// records the operation, and catchUpSyncs(), called at the thread's
+  /// next turn, updates the runtime's state of the objects and logs the
+  /// operations in the order they ran.
+  bool turnFreeSync();
+  void deferSync(unsigned ins, unsigned short op, void *obj, int ret, uint64_t arg = 0);
+  void catchUpSyncs();
+  /// whether @obj is one of the calling thread's private objects; its
+  /// mutex engine state goes to @m. May be called without turn
+  bool myPrivateSync(void *obj, det_mutex_t *&m);
   int pthreadRWLockWrLockHelper(pthread_rwlock_t *rwlock, unsigned timeout = Scheduler::FOREVER);
   int pthreadRWLockRdLockHelper(pthread_rwlock_t *rwlock, unsigned timeout = Scheduler::FOREVER);
-  
-  /// for each pthread barrier, track the count of the number and number
-  /// of threads arrived at the barrier
-  barrier_map barriers;
+  int pthreadRWLockTimedLockHelper(unsigned ins, int &error, pthread_rwlock_t *rwlock,
+                                   const struct timespec *abstime, bool write);
 
-  /// for each opaque type, track the its ref counted barrier.
-  refcnt_bar_map refcnt_bars;
+  /// the rwlock engine: readers and writer live in the rwlock's record, and an
+  /// unlock that frees the lock hands it to the next writer or to all
+  /// waiting readers at once. All must be called with turn held and return
+  /// what the pthread function would; @wait = false gives the trylock.
+  bool useRWLockEngine();
+  det_rwlock_t &detRWLock(pthread_rwlock_t *rwlock);
+  int detRWLockRdLock(pthread_rwlock_t *rwlock, bool wait, unsigned timeout = Scheduler::FOREVER);
+  int detRWLockWrLock(pthread_rwlock_t *rwlock, bool wait, unsigned timeout = Scheduler::FOREVER);
+  int detRWLockUnlock(pthread_rwlock_t *rwlock);
+
+  /// the barrier engine: a pthread_barrier_t holds a pointer to its
+  /// record, and the last arriving thread releases the others with one
+  /// splice of the record's waiters. All must be called with turn held and
+  /// return what the pthread function would.
+  int detBarrierInit(pthread_barrier_t *barrier, unsigned count);
+  sync_obj_t *detBarrier(pthread_barrier_t *barrier);
+  int detBarrierWait(pthread_barrier_t *barrier);
+  int detBarrierDestroy(pthread_barrier_t *barrier);
+  void resetBarriers();
+
+  /// the semaphore engine: the count lives in the sem's record, and a post with
+  /// waiters hands its unit to the first of them instead of counting it.
+  /// Must be called with turn held. detSemWait() returns 0, EAGAIN if
+  /// !@wait and the count is 0, or ETIMEDOUT.
+  det_sem_t &detSem(sem_t *sem);
+  int detSemWait(sem_t *sem, bool wait, unsigned timeout = Scheduler::FOREVER);
+  int detSemPost(sem_t *sem);
+  
+  /// private objects and pending requests of each thread, by tid; the
+  /// owner of each object is in its record (sync_obj_t::private_owner)
+  slot_table<private_syncs_t> private_syncs;
+  /// number of requests in @private_syncs
+  unsigned nPrivateSyncRequests;
 
   /// need these semaphores to assign tid deterministically; see comments
   /// for pthreadCreate() and threadBegin()
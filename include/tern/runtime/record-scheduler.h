@@ -20,11 +20,9 @@
 // Refactored from Heming's Memoizer code
 //
 // TODO:
-// 1. use multiple wait queues per waitvar, instead of one for all
-//    waitvars, for performance?
-// 2. implement random scheduler
-// 3. implement replay scheduler
-// 4. support break out of turn.  RR can deadlock if program uses ad hoc
+// 1. implement random scheduler
+// 2. implement replay scheduler
+// 3. support break out of turn.  RR can deadlock if program uses ad hoc
 //    sync, such as "while(flag)"
 
 #ifndef __TERN_RECORDER_SCHEDULER_H
@@ -40,6 +38,7 @@
 #include <semaphore.h>
 #include <tr1/unordered_set>
 #include "tern/runtime/scheduler.h"
+#include "tern/options.h"
 
 
 namespace tern {
@@ -85,9 +84,8 @@ protected:
 };
 
 
-/// TODO: one optimization is to change the single wait queue to be
-/// multiple wait queues keyed by the address they wait on, therefore no
-/// need to scan the mixed wait queue.
+/// Blocked threads are kept in wait queues keyed by the address they wait
+/// on (see wait-queue.h), so signal() does not scan other waiters.
 struct RRScheduler: public Scheduler {
   typedef Scheduler Parent;
   
@@ -95,32 +93,70 @@ struct RRScheduler: public Scheduler {
     pthread_mutex_t mutex;
     pthread_cond_t cond;
     sem_t    sem;
-    void*    chan;
-    unsigned timeout;
     int      status; // return value of wait()
     volatile bool wakenUp;
+    /// inside wait() (see isWaiting()); only changed by the owner thread with turn held
+    bool waiting;
+    /// futex relay word: FUTEX_IDLE, FUTEX_POSTED or FUTEX_PARKED
+    volatile int futex;
+
+    enum {FUTEX_IDLE = 0, FUTEX_POSTED = 1, FUTEX_PARKED = 2};
+
+    /// current spin window of the hybrid relay, in sched_yield()s (adaptive_spin)
+    long spinBudget;
+    /// handoffs caught while spinning / after parking, and CPU time burned
+    /// spinning (record_runtime_stat); only updated by the owner thread
+    long nSpins;
+    long nParks;
+    long long nSpinNs;
+    /// the owner kept the turn in putTurn() (solo_fast_path, turn_quantum),
+    /// so its next getTurn() returns at once; only changed by the owner thread
+    bool kept;
+    /// operations the owner has done in its current turn, counted against
+    /// turn_quantum; only changed by the owner thread
+    int quantumOps;
+    /// the owner sleeps on @cond (hybrid relay), a hint for prewake()
+    volatile bool parked;
+    /// prewake() woke the owner up before the post (hybrid relay)
+    bool prewoken;
 
     void reset(int st=0) {
-      chan = NULL;
-      timeout = FOREVER;
       status = st;
       wakenUp = false;
+      futex = FUTEX_IDLE;
+      waiting = false;
+      kept = false;
+      quantumOps = 0;
+      parked = false;
+      prewoken = false;
     }
 
     wait_t() {
       pthread_mutex_init(&mutex, NULL);
       pthread_cond_init(&cond, NULL);
       sem_init(&sem, 0, 0);
+      spinBudget = options::spin_count_min;
+      nSpins = nParks = 0;
+      nSpinNs = 0;
       reset(0);
     }    
     void wait();
     void post();
+    /// wake the owner up if it sleeps, so that it spins (prewake_spin_count)
+    /// for a post() that is on its way
+    void prewake();
   }__attribute__((aligned(64)));  // Typical cache alignment.
 
   virtual void getTurn();
   virtual void putTurn(bool at_thread_end = false);
   virtual int  wait(void *chan, unsigned timeout = Scheduler::FOREVER);
   virtual std::list<int> signal(void *chan, bool all=false);
+  virtual int waitList(wait_queue::list_t &l, unsigned timeout = Scheduler::FOREVER);
+  virtual size_t signalList(wait_queue::list_t &l);
+  virtual size_t transfer(void *chan, void *to, bool all=false);
+  virtual int signalFirst(void *chan);
+  virtual size_t numWaiters(void *chan);
+  virtual bool isWaiting(int tid);
 
   virtual int block(); 
   virtual bool interProStart();
@@ -129,17 +165,34 @@ struct RRScheduler: public Scheduler {
 
   unsigned incTurnCount(void);
   unsigned getTurnCount(void);
+  virtual void getRelayStat(long &nSpins, long &nParks, long long &nSpinNs);
+  virtual unsigned warpToNextTimeout();
 
   void childForkReturn();
 
+  /// also creates (or, for a recycled tid, resets) the wait slot of the new thread
+  void create(pthread_t new_th);
+
   RRScheduler();
   ~RRScheduler();
 
 protected:
 
-  /// timeout threads on @waitq
+  /// common part of wait() and waitList(): park on @l if not NULL, or on @chan
+  int waitOn(void *chan, unsigned timeout, wait_queue::list_t *l);
+  /// whether the turn holder @tid can keep the turn instead of passing it
+  /// on (solo_fast_path, turn_quantum)
+  bool keepTurn(int tid);
+  bool idleAwake();
+  /// prewake() the threads after the turn holder on @runq (prewake_depth)
+  void prewakeNext();
+  /// timeout threads on @waitq; O(1) if no timeout is due
   int fireTimeouts();
-  /// return the next timeout turn number
+  /// scratch buffer of fireTimeouts()
+  std::vector<run_queue::runq_elem*> timedout_elems;
+  /// move a thread off @waitq to the tail of @runq, setting its wait() return value to @status
+  void wakeWaiter(struct run_queue::runq_elem *elem, int status);
+  /// return the next timeout turn number in O(1)
   unsigned nextTimeout();
   /// pop the @runq and wakes up the thread at the front of @runq
   virtual void next(bool at_thread_end=false, bool hasPoppedFront = false);
@@ -164,15 +217,29 @@ protected:
 
   // MAYBE: can use a thread-local wait struct for each thread if it
   // improves performance
-  wait_t waits[MAX_THREAD_NUM];
-
-  //  for inter-process operation wakeup
-  typedef std::tr1::unordered_set<int> tid_set;
-  tid_set inter_pro_wakeup_tids;
-  bool inter_pro_wakeup_flag;
-  pthread_mutex_t inter_pro_wakeup_mutex;
+  slot_table<wait_t> waits;
+
+  /** For inter-process operation wakeup. Threads returning from blocking calls
+  push their run queue elements onto this lock-free stack (linked through
+  runq_elem::wake_next); the turn holder detaches the whole stack at once in
+  check_wakeup() and appends the threads to @runq in ascending tid order, so
+  the order does not depend on which thread got there first. **/
+  struct run_queue::runq_elem * volatile inter_pro_wakeup_head;
+  std::vector<int> inter_pro_wakeup_tids; // scratch buffer of check_wakeup()
   void check_wakeup();
 
+  /** Token recovery, used instead of the idle thread (launch_idle_thread = 0).
+  When the run queue drains, the turn holder first refills it from wakeups,
+  non-det starters or the next timeout (refillRunq()). If there is nothing to
+  run, every thread is in a blocking call or waits forever, so the token is
+  parked (parkToken()) and nobody holds the turn. The first thread coming
+  back through wakeup() takes the token (reclaimToken()) and passes it on as
+  if it had the turn. **/
+  volatile int token_parked;
+  bool refillRunq();
+  bool parkToken();
+  virtual void reclaimToken();
+
   // For idle thread.
   void wakeUpIdleThread();
   void idleThreadCondWait();
@@ -25,8 +25,10 @@
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
+#include <new>
+#include "slot-table.h"
 
-#define MAX_THREAD_NUM 5000///1111
 //#define DEBUG_RUN_QUEUE // "defined" means enable the debug check; "undef" means disable it (faster).
 
 #ifdef DEBUG_RUN_QUEUE
@@ -88,28 +90,57 @@ public:
     INTER_PRO_STOP      /** The thread is stopped (or blocked) on a inter-process operation, and no other thread can pass turn to it. **/
   };
   
+  /** Each element sits on its own cache line(s), so the head thread passing the turn and a
+  thread starting or ending a blocking operation never share a line. **/
   struct runq_elem {
   public:
-    pthread_spinlock_t spin_lock;
     int tid;
-    THD_STATUS status;
+    /** A THD_STATUS. Moved between states only by compare-and-swap (cas_status()) when
+    another thread may change it at the same time; see RRScheduler::interProStart(). **/
+    volatile int status;
+    /** Links in the run queue, or in the wait queue of @wait_chan while the thread is blocked. **/
     struct runq_elem *prev;
     struct runq_elem *next;
 
+    /** Owned by wait_queue (see wait-queue.h). They are only meaningful while the thread is blocked. **/
+    void *wait_chan;
+    unsigned wait_timeout;
+    unsigned long wait_seq;
+    int heap_index;
+
+    /** Link in RRScheduler's lock-free wakeup list, and whether the thread is on it. **/
+    struct runq_elem *wake_next;
+    volatile int wake_pending;
+
     runq_elem(int tid) {
-      pthread_spin_init(&spin_lock, 0);
+      reset(tid);
+    }
+
+    /** Atomically move status from @from to @to; return false if it was not @from. **/
+    inline bool cas_status(int from, int to) {
+      return __sync_bool_compare_and_swap(&status, from, to);
+    }
+
+    /** Also used when a recycled tid gets a new thread. **/
+    void reset(int tid) {
       this->tid = tid;
       status = RUNNABLE;
       prev = next = NULL;
+      wait_chan = NULL;
+      wait_timeout = 0;
+      wait_seq = 0;
+      heap_index = -1;
+      wake_next = NULL;
+      wake_pending = 0;
     }
-  };
+  } __attribute__((aligned(64)));  // Typical cache alignment.
 
 private:
   /** Key members of the run queue. We mainly optimize it for read/write of head/tail. **/
   struct runq_elem *head;
   struct runq_elem *tail;
   size_t num_elements;
-  struct runq_elem *tid_map[MAX_THREAD_NUM];
+  slot_table<struct runq_elem *> tid_map;
 
   /** This one is useful only when DEBUG_RUN_QUEUE is defined. **/
   std::tr1::unordered_set<void *> elements;
@@ -164,7 +195,6 @@ public:
   };
 
   run_queue() {
-    memset(tid_map, 0, sizeof(struct runq_elem *)*MAX_THREAD_NUM);
     deep_clear();
   }
 
@@ -181,11 +211,25 @@ public:
   
   inline struct runq_elem *create_thd_elem(int tid) {
     //fprintf(stderr, "tid %d is called with runq::create_thd_elem\n", tid);
-    ASSERT(tid >= 0 && tid < MAX_THREAD_NUM);
-    ASSERT(tid_map[tid] == NULL);
-    struct runq_elem *elem = new runq_elem(tid);
-    tid_map[tid] = elem;
-    return elem;
+    ASSERT(tid >= 0);
+    struct runq_elem *&slot = tid_map.ensure(tid);
+    if (slot != NULL) { /** A recycled tid; its old thread has exited and left the queues. **/
+      DBG_ASSERT_ELEM_NOT_IN(__FUNCTION__, slot);
+      slot->reset(tid);
+      return slot;
+    }
+    void *mem = NULL;
+    if (posix_memalign(&mem, __alignof__(struct runq_elem), sizeof(struct runq_elem)) != 0)
+      assert(false && "can't allocate run queue element");
+    slot = new (mem) runq_elem(tid);
+    return slot;
+  }
+
+  /** Make @elem, created by another run queue, the element of @tid here too. The queues then
+  share the element, so a thread can move between them; only its creator frees it. **/
+  inline void share_thd_elem(int tid, struct runq_elem *elem) {
+    ASSERT(elem && elem->tid == tid);
+    tid_map.ensure(tid) = elem;
   }
 
   inline void del_thd_elem(int tid) {
@@ -193,8 +237,8 @@ public:
     struct runq_elem *elem = tid_map[tid];
     ASSERT(elem);
     tid_map[tid] = NULL;
-    pthread_spin_destroy(&(elem->spin_lock));
-    delete elem;
+    elem->~runq_elem();
+    free(elem);
   }
 
   inline void dbg_assert_elem_in(const char *tag, struct runq_elem *elem) {
@@ -204,7 +248,7 @@ public:
     int i = 0;
     //fprintf(stderr, "\n\n OP: %s: elements set size %u\n", tag, (unsigned)elements.size());
     for (run_queue::iterator itr = begin(); itr != end(); ++itr) {
-      if (i > MAX_THREAD_NUM)
+      if (i > tid_map.size())
         assert(false);
       //fprintf(stderr, "q[%d] = tid %d, status = %d\n", i, *itr, itr->status);
       i++;
@@ -259,7 +303,9 @@ public:
   }
 
   /** Check whether current element is in the queue. Only the head-of run queue should call this function,
-  because it is the only thread which could modify the linked list of run queue. **/
+  because it is the only thread which could modify the linked list of run queue. Membership is inferred
+  from the prev/next links, which the wait queues use too, so an element must never be on both kinds of
+  list at once; push_back() and push_front() check that it is on none (see assert_unlinked()). **/
   inline bool in(int tid) {
     struct runq_elem *elem = tid_map[tid];
     ASSERT(elem);
@@ -284,8 +330,8 @@ public:
     head = tail = NULL;
     num_elements = 0;
     DBG_CLEAR_ALL_ELEMS();
-    for (int i = 0; i < MAX_THREAD_NUM; i++) {// An un-opt version, TBD.
-      if (tid_map[i] != NULL) {
+    for (int i = 0; i < tid_map.size(); i++) { // Only slots ever created.
+      if (tid_map.has(i) && tid_map[i] != NULL) {
         int tid = tid_map[i]->tid;
         tid_map[i]->prev = tid_map[i]->next = NULL;
         del_thd_elem(tid); // Deep clear.
@@ -335,6 +381,12 @@ public:
     }
   }
   
+  /** An element entering the run queue must be on no list: not linked (into this queue or a wait
+  queue), and not the only element of this queue. **/
+  inline void assert_unlinked(struct runq_elem *elem) {
+    assert(elem->prev == NULL && elem->next == NULL && head != elem);
+  }
+
   inline void push_back(int tid) {
     PRINT("push_back_start");
     //fprintf(stderr, "~~~~~~~~~~~~push back tid %d\n", tid);
@@ -342,6 +394,7 @@ public:
     struct runq_elem *elem = tid_map[tid];
     ASSERT(elem);
     DBG_ASSERT_ELEM_NOT_IN(__FUNCTION__, elem);
+    assert_unlinked(elem);
     if (head == NULL) {
       ASSERT(tail == NULL);
       head = tail = elem;
@@ -376,22 +429,48 @@ public:
     struct runq_elem *elem = tid_map[tid];
     ASSERT(elem);
     DBG_ASSERT_ELEM_NOT_IN(__FUNCTION__, elem);
+    assert_unlinked(elem);
     if (head == NULL) {
       head = tail = elem;
     } else {
       elem->next = head;
+      head->prev = elem;
       head = elem;
     }
     DBG_INSERT_ELEM(__FUNCTION__, elem);
     num_elements++;
   }
 
+  /** Append the chain @first ... @last (linked by prev/next, @n elements) to the tail of the queue in O(1).
+  The wait queues use it to move all the waiters of a channel to the run queue at once. **/
+  inline void splice_back(struct runq_elem *first, struct runq_elem *last, size_t n) {
+    PRINT(__FUNCTION__);
+    ASSERT(first && last && n > 0);
+#ifdef DEBUG_RUN_QUEUE
+    for (struct runq_elem *elem = first; elem; elem = elem->next) {
+      DBG_ASSERT_ELEM_NOT_IN(__FUNCTION__, elem);
+      DBG_INSERT_ELEM(__FUNCTION__, elem);
+    }
+#endif
+    first->prev = tail;
+    last->next = NULL;
+    if (head == NULL) {
+      ASSERT(tail == NULL);
+      head = first;
+    } else
+      tail->next = first;
+    tail = last;
+    num_elements += n;
+  }
+
   inline void pop_front() {
     PRINT(__FUNCTION__);
     struct runq_elem *elem = head;
     DBG_ASSERT_ELEM_IN(__FUNCTION__, elem);
     head = elem->next;
     elem->prev = elem->next = NULL;
+    if (head != NULL)
+      head->prev = NULL;
     if (head == NULL) /** If head is empty, then the tail must also be empty. **/
       tail = NULL;
     DBG_ERASE_ELEM(__FUNCTION__, elem);
@@ -405,7 +484,7 @@ public:
     int i = 0;
     fprintf(stderr, "\n\n OP: %s: elements set size %u\n", tag, (unsigned)elements.size());
     for (run_queue::iterator itr = begin(); itr != end(); ++itr) {
-      if (i > MAX_THREAD_NUM)
+      if (i > tid_map.size())
         assert(false);
       fprintf(stderr, "q[%d] = tid %d, status = %d\n", i, *itr, itr->status);
       i++;
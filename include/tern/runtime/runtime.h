@@ -75,11 +75,13 @@ struct Runtime {
 
   // semaphore
   virtual int semInit(unsigned insid, int &error, sem_t *sem, int pshared, unsigned int value) = 0;
+  virtual int semDestroy(unsigned insid, int &error, sem_t *sem) = 0;
   virtual int semWait(unsigned insid, int &error, sem_t *sem) = 0;
   virtual int semTryWait(unsigned insid, int &error, sem_t *sem) = 0;
   virtual int semTimedWait(unsigned insid, int &error, sem_t *sem,
                            const struct timespec *abstime) = 0;
   virtual int semPost(unsigned insid, int &error, sem_t *sem) = 0;
+  virtual int semGetValue(unsigned insid, int &error, sem_t *sem, int *sval) = 0;
 
   // new programming primitives
   virtual void lineupInit(long opaque_type, unsigned count, unsigned timeout_turns) = 0;
@@ -91,6 +93,10 @@ struct Runtime {
   virtual void threadDetach() = 0;
   virtual void nonDetBarrierEnd(int bar_id, int cnt) = 0;
   virtual void setBaseTime(struct timespec *ts) = 0;
+  virtual void setDomain(int domain) = 0;
+  /// @return whether the thread should call preempt() (backedge_preempt)
+  virtual bool backEdge(int id) = 0;
+  virtual void preempt(int id) = 0;
 
   // print runtime stat.
   virtual void printStat() = 0;
@@ -171,6 +177,7 @@ struct Runtime {
 */
 
   virtual int __sem_init(unsigned insid, int &error, sem_t *sem, int pshared, unsigned int value);
+  virtual int __sem_destroy(unsigned insid, int &error, sem_t *sem);
   virtual int __sem_wait(unsigned insid, int &error, sem_t *sem);
   virtual int __sem_post(unsigned insid, int &error, sem_t *sem);
 
@@ -250,6 +257,8 @@ XDEF(pthread_rwlock_wrlock, Synchronization, int, pthread_rwlock_t *rwlock)
 XDEF(pthread_rwlock_unlock, Synchronization, int, pthread_rwlock_t *rwlock)
 XDEF(pthread_rwlock_destroy, Synchronization, int, pthread_rwlock_t *rwlock)
 XDEF(pthread_rwlock_init, Synchronization, int, pthread_rwlock_t * rwlock, const pthread_rwlockattr_t * attr) 
+XDEF(pthread_rwlock_timedrdlock, Synchronization, int, pthread_rwlock_t * rwlock, const struct timespec * abs_timeout)
+XDEF(pthread_rwlock_timedwrlock, Synchronization, int, pthread_rwlock_t * rwlock, const struct timespec * abs_timeout)
 #undef XDEF
 
   /// Installs a runtime as @the.  A runtime implementation must
@@ -24,9 +24,12 @@
 #include <limits.h>
 #include <stdio.h>
 #include <list>
+#include <set>
+#include <vector>
 #include <tr1/unordered_map>
 #include <tr1/unordered_set>
 #include "run-queue.h"
+#include "wait-queue.h"
 #include "non-det-thread-set.h"
 
 extern "C" {
@@ -40,20 +43,41 @@ namespace tern {
 /// reverse map from pthread tid to tern tid.  This class itself doesn't
 /// synchronize its methods; instead, the callers of these methods must
 /// ensure that the methods are synchronized.
+///
+/// The tid of a joined or detached thread is recycled: create() hands out
+/// the lowest free tid, so long-running programs that keep creating and
+/// joining (or detaching) threads use a bounded range of tids.  Since
+/// create(), detach(), zombify() and reap() are called with the turn held,
+/// the reuse is deterministic.
 struct TidMap {
   enum {MainThreadTid = 0, IdleThreadTid = 1, InvalidTid = -1};
 
   typedef std::tr1::unordered_map<pthread_t, int> pthread_to_tern_map;
   typedef std::tr1::unordered_map<int, pthread_t> tern_to_pthread_map;
-  typedef std::tr1::unordered_set<pthread_t>      pthread_tid_set;
+  typedef pthread_to_tern_map                     pthread_tid_map;
 
   /// create a new tern tid and map pthread_tid to this new id
   int create(pthread_t pthread_th) {
     pthread_to_tern_map::iterator it = p_t_map.find(pthread_th);
     assert(it==p_t_map.end() && "pthread tid already in map!");
-    p_t_map[pthread_th] = nthread;
-    t_p_map[nthread] = pthread_th;
-    return nthread++;
+    int tid;
+    if (!free_tids.empty()) {
+      tid = *free_tids.begin();
+      free_tids.erase(free_tids.begin());
+      generations[tid]++;
+    } else {
+      tid = nthread++;
+      generations.push_back(0);
+    }
+    p_t_map[pthread_th] = tid;
+    t_p_map[tid] = pthread_th;
+    return tid;
+  }
+
+  /// how many times @tid has been recycled (0 for its first thread)
+  int generation(int tid) {
+    assert(tid >= 0 && tid < nthread);
+    return generations[tid];
   }
 
   /// sets thread-local tern tid to be the tid of @self_th
@@ -65,19 +89,42 @@ struct TidMap {
     self_tid = it->second;
   }
 
-  /// remove thread @tern_tid from the maps and insert it into the zombie set
+  /// remove thread @tern_tid from the maps and insert it into the zombie
+  /// set; a detached thread frees its tid at once instead, since nobody
+  /// will join it.  The thread calls this in its last putTurn(), and does
+  /// not use its tid after it passes the turn on.
   void zombify(pthread_t self_th) {
     tern_to_pthread_map::iterator it = t_p_map.find(self());
     assert(it!=t_p_map.end() && "tern tid not in map!");
     assert(self_th==it->second && "mismatch between pthread tid and tern tid!");
-    zombies.insert(it->second);
+    if (detached.erase(self_th)) {
+      if (it->first != MainThreadTid && it->first != IdleThreadTid)
+        free_tids.insert(it->first);
+    } else
+      zombies[it->second] = it->first;
     p_t_map.erase(it->second);
     t_p_map.erase(it);
   }
 
-  /// remove thread @pthread_th from the maps
+  /// mark thread @pthread_th as detached, so that it frees its tid when
+  /// it ends; if it has ended already, free its tid now.
+  void detach(pthread_t pthread_th) {
+    if (zombie(pthread_th))
+      reap(pthread_th);
+    else if (p_t_map.find(pthread_th) != p_t_map.end())
+      detached.insert(pthread_th);
+  }
+
+  /// remove thread @pthread_th from the maps, and free its tid for reuse.
+  /// The thread has fully exited (it was joined), so nothing refers to
+  /// its tid any more.
   void reap(pthread_t pthread_th) {
-    zombies.erase(pthread_th);
+    pthread_tid_map::iterator it = zombies.find(pthread_th);
+    if (it == zombies.end())
+      return;
+    if (it->second != MainThreadTid && it->second != IdleThreadTid)
+      free_tids.insert(it->second);
+    zombies.erase(it);
   }
 
   /// return tern tid of thread @pthread_th
@@ -98,7 +145,7 @@ struct TidMap {
 
   /// return if thread @pthread_th is in the zombie set
   bool zombie(pthread_t pthread_th) {
-    pthread_tid_set::iterator it = zombies.find(pthread_th);
+    pthread_tid_map::iterator it = zombies.find(pthread_th);
     return it!=zombies.end();
   }
 
@@ -127,14 +174,20 @@ protected:
     p_t_map.clear();
     t_p_map.clear();
     zombies.clear();
+    detached.clear();
+    free_tids.clear();
+    generations.clear();
 
     init(main_th);
   }
 
   pthread_to_tern_map p_t_map;
   tern_to_pthread_map t_p_map;
-  pthread_tid_set     zombies;
-  int nthread;
+  pthread_tid_map     zombies; // pthread tid -> its former tern tid
+  std::tr1::unordered_set<pthread_t> detached; // live threads nobody will join
+  std::set<int>       free_tids; // reaped tids, reused lowest first
+  std::vector<int>    generations;
+  int nthread; // 1 + the largest tid ever handed out
 };
 
 /// @Serializer defines the interface for a serializer that ensures that
@@ -166,9 +219,74 @@ struct Serializer: public TidMap {
   /// requirement as wait()
   virtual std::list<int> signal(void *chan, bool all = false) { std::list<int> l; return l; }
 
+  /// move one (@all = false) or all (@all = true) threads waiting on
+  /// @chan to wait on @to instead, without waking them up; must call with
+  /// turn held.  return the number of threads moved.  NOP for serializers
+  /// without wait queues.
+  virtual size_t transfer(void *chan, void *to, bool all = false) { return 0; }
+
+  /// wait() on a wait queue list the caller already has (the waiters of a
+  /// sync table record, or a list kept inside the sync object) instead of
+  /// a channel looked up in the wait queues; only the lists of records may
+  /// be waited on with a timeout.  signalList(@l) wakes up all its waiters
+  /// at once and returns their number.  Both must be called with turn held
+  virtual int waitList(wait_queue::list_t &l, unsigned timeout = FOREVER) {
+    return wait(l.chan, timeout);
+  }
+  virtual size_t signalList(wait_queue::list_t &l) { return 0; }
+
+  /// wake up the first thread waiting on @chan and return its tid, or
+  /// InvalidTid if no thread waits on @chan; must call with turn held
+  virtual int signalFirst(void *chan) { return InvalidTid; }
+
+  /// number of threads waiting on @chan, i.e., the number signal(@chan,
+  /// true) would wake up now; must call with turn held
+  virtual size_t numWaiters(void *chan) { return 0; }
+
+  /// whether thread @tid is inside wait(), so it runs no application code
+  /// until it gets the turn again; must call with turn held
+  virtual bool isWaiting(int tid) { return false; }
+
+  /// the table of sync object records the runtime keeps its state in (see
+  /// sync-table.h); a serializer has no wait queues to share it with
+  sync_table &syncObjects() {
+    static sync_table objs;
+    return objs;
+  }
+
   /// get the turn so that other threads trying to get the turn must wait
   virtual void getTurn() { }
 
+  /// get the turn for an operation on sync objects @obj and @obj2 (either
+  /// may be NULL) only; a scheduler with several turns (see
+  /// shard-scheduler.h) may then run it in parallel with operations on
+  /// unrelated objects.  getTurn() is for operations that may touch any
+  /// thread or object
+  virtual void getTurnOn(void *obj, void *obj2 = NULL) { getTurn(); }
+
+  /// the sync object @obj is destroyed; must call with turn held.  NOP
+  /// for serializers that keep nothing per object
+  virtual void forgetSyncObj(void *obj) { }
+
+  /// move the calling thread to scheduling domain @domain when it puts
+  /// the turn; must call with turn held.  NOP for serializers with a
+  /// single turn
+  virtual void setDomain(int domain) { }
+
+  /// the calling thread made @n more units of deterministic progress
+  /// (loop back-edges); called without turn, by the thread itself.  NOP
+  /// for serializers that do not order threads by logical clocks
+  virtual void advanceClock(unsigned n) { }
+
+  /// add up how many turn handoffs were caught by spinning or by sleeping,
+  /// and the CPU time spent spinning. NOP for serializers without a relay.
+  virtual void getRelayStat(long &nSpins, long &nParks, long long &nSpinNs) { }
+
+  /// called by the idle thread with turn held; if no other thread can run
+  /// until a wait timeout, advance turnCount to that timeout and return the
+  /// number of turns skipped. NOP for serializers without timeouts.
+  virtual unsigned warpToNextTimeout() { return 0; }
+
   /// give up the turn so that other threads can get the turn.  this
   /// method should also increment turnCount
   virtual void putTurn(bool at_thread_end=false) { }
@@ -208,6 +326,10 @@ struct Serializer: public TidMap {
   /// turn held
   void join(pthread_t th) { TidMap::reap(th); }
 
+  /// inform the serializer that thread @th is detached; must call with
+  /// turn held
+  void detach(pthread_t th) { TidMap::detach(th); }
+
   /// child process begins
   void childForkReturn() { TidMap::reset(pthread_self()); }
 
@@ -274,8 +396,11 @@ struct Scheduler: public Serializer {
     // Note: no need to clean up non_det_thds here, because they are only thread integer ids, not pointers in runq.
   }
 
+  /// the records are shared with the wait queues
+  sync_table &syncObjects() { return waitq.objects(); }
+
   run_queue runq;
-  std::list<int>  waitq;
+  wait_queue waitq;
   non_det_thread_set non_det_thds;
 };
 
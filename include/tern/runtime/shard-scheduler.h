@@ -0,0 +1,159 @@
+/* Copyright (c) 2013,  Regents of the Columbia University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __TERN_SHARD_SCHEDULER_H
+#define __TERN_SHARD_SCHEDULER_H
+
+#include <vector>
+#include <pthread.h>
+#include "tern/runtime/record-scheduler.h"
+
+namespace tern {
+
+/** Round-robin scheduling with one turn per shard (options::turn_shards).
+
+Each thread belongs to a shard, and each shard passes its own turn around
+its own run queue, as RRScheduler does with the single one. A sync object
+belongs to the shard of the first thread that uses it, and an operation
+on objects of the caller's shard only (getTurnOn()) runs with the shard's
+turn, without waiting for threads of other shards.
+
+Shards run at different speeds, so whatever could let two shards see each
+other must not happen while they run: any other operation (getTurn(), or
+getTurnOn() with an object of no shard yet or of another shard) waits for
+the serial phase. The shards run in rounds. A shard stops once its threads
+have done shard_round_turns operations, or none of them can run; when all
+shards have stopped, the serial phase runs the waiting operations one at a
+time, ordered by the shard they were requested from and their order within
+it, fires wait timeouts and takes back threads returning from blocking
+calls, and then starts the next round. Each step depends only on what the
+threads of one shard did, so the schedule stays deterministic. A thread
+ends its serial operation in the shard of the first object it used, so
+threads sharing objects end up in the same shard.
+
+Turn counts: a round starts at the turn count the serial phase left
+(@base), and each shard counts its own operations from there; the next
+serial phase starts past the busiest shard. Timeouts thus only fire
+between rounds.
+
+With options::turn_domains, the shards are scheduling domains instead:
+threads do not move to the shard of the objects they use, but stay in the
+one they were created in (their creator's, or the one thread_domains gives
+their creation order) until they move with setDomain().
+
+A single lock (@state_lock) guards the scheduler and the runtime's state
+(the sync table, the logs, ...): the holder of any turn takes it for the
+duration of its operation only. **/
+struct ShardScheduler: public RRScheduler {
+  typedef RRScheduler Parent;
+
+  virtual void getTurn();
+  virtual void getTurnOn(void *obj, void *obj2 = NULL);
+  virtual void putTurn(bool at_thread_end = false);
+  virtual int  wait(void *chan, unsigned timeout = Scheduler::FOREVER);
+  virtual std::list<int> signal(void *chan, bool all=false);
+  virtual int waitList(wait_queue::list_t &l, unsigned timeout = Scheduler::FOREVER);
+  virtual size_t signalList(wait_queue::list_t &l);
+  virtual size_t transfer(void *chan, void *to, bool all=false);
+  virtual int signalFirst(void *chan);
+  virtual size_t numWaiters(void *chan);
+  virtual void forgetSyncObj(void *obj);
+  virtual void setDomain(int domain);
+
+  virtual int block();
+
+  unsigned incTurnCount(void);
+  unsigned getTurnCount(void);
+
+  void childForkReturn();
+
+  /// also puts the new thread in a shard: the one thread_domains gives,
+  /// else its creator's with turn_domains, else round-robin by creation order
+  void create(pthread_t new_th);
+
+  ShardScheduler();
+  ~ShardScheduler();
+
+protected:
+  struct shard_t {
+    run_queue q;        // the threads of the shard that are not waiting
+    unsigned nturns;    // operations run in the shard this round
+    unsigned nrequests; // serial operations requested from the shard this round
+    bool stopped;       // done for this round
+  };
+
+  struct thd_t {
+    int shard;      // the shard the thread belongs to
+    int dest;       // the shard it moves to when its serial operation ends
+    bool serial;    // it runs, or waits within, a serial operation
+    void *objs[2];  // the objects of its serial operation
+  };
+
+  /// a serial operation, or a serial waiter to wake up, in the order of
+  /// the serial phase
+  struct request_t {
+    unsigned shard;
+    unsigned seq;
+    int tid;
+    bool operator<(const request_t &r) const {
+      return shard < r.shard || (shard == r.shard && seq < r.seq);
+    }
+  };
+
+  int nshards;
+  bool by_domain;         // the shards are domains (options::turn_domains)
+  /// shard of the n-th thread created (options::thread_domains), -1 if unset
+  std::vector<int> placement;
+  std::vector<shard_t*> shards;
+  slot_table<thd_t> thds;
+  std::vector<request_t> requests;
+  size_t next_request;
+
+  pthread_mutex_t state_lock;
+  bool serial_phase;
+  unsigned base;          // turn count at the start of the round
+  unsigned serial_clock;  // turn count of the serial phase
+  int nstopped;           // shards done for this round
+  unsigned ncreated;      // threads created so far, to place new ones
+  /// scratch queue of the threads a broadcast wakes up
+  run_queue woken;
+
+  void enter(bool serial, void *obj, void *obj2);
+  /// the shard options::thread_domains puts the @n-th thread created in, or
+  /// @otherwise
+  int  placeThread(unsigned n, int otherwise);
+  int  waitOn(void *chan, unsigned timeout, wait_queue::list_t *l);
+  bool inShard(void *obj, int s);
+  /// queue @tid for the serial phase, after the requests made so far
+  void request(int tid);
+  /// make @elem runnable again, with wait() returning @status
+  void wake(run_queue::runq_elem *elem, int status);
+  void wakeAll(run_queue &q);
+  int  nextInShard(int s);
+  void passShard(int s);
+  void beginSerial();
+  void passSerial();
+  bool startRound();
+  void fireShardTimeouts();
+  void drainWakeups();
+  virtual void reclaimToken();
+};
+
+} // namespace tern
+
+#endif
@@ -0,0 +1,123 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __TERN_COMMON_RUNTIME_SLOT_TABLE_H
+#define __TERN_COMMON_RUNTIME_SLOT_TABLE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <new>
+
+namespace tern {
+/** A growable table of per-thread slots indexed by tid.
+
+Slots live in segments of geometrically growing size (64, 128, 256, ...) that are
+allocated only when a tid in their range is first used, so a small program pays for
+a few dozen slots and a big server is not capped by a compile-time constant. Segments
+never move, so the address of a slot stays valid for the life of the table and
+readers need no lock: a slot must be created with ensure() (by the thread holding
+the turn, before the thread owning it starts) before anyone reads it with [].
+
+T must be default constructible; over-aligned types (e.g., cache aligned) are honored. **/
+template <typename T>
+class slot_table {
+  enum {FIRST_SEGMENT_BITS = 6, NUM_SEGMENTS = 24}; // 64 * (2^24 - 1) slots at most
+
+  T *segments[NUM_SEGMENTS];
+  int high_water; // 1 + the largest index ever ensured
+
+  /** Slot @idx is at offset @off of segment @return. **/
+  static inline unsigned locate(unsigned idx, unsigned &off) {
+    unsigned j = (idx >> FIRST_SEGMENT_BITS) + 1;
+    unsigned seg = 31 - __builtin_clz(j);
+    off = idx - (((1u << seg) - 1) << FIRST_SEGMENT_BITS);
+    return seg;
+  }
+
+  static inline size_t segment_size(unsigned seg) {
+    return (size_t)1 << (seg + FIRST_SEGMENT_BITS);
+  }
+
+  T *alloc_segment(unsigned seg) {
+    size_t n = segment_size(seg);
+    size_t align = __alignof__(T) > sizeof(void *) ? __alignof__(T) : sizeof(void *);
+    void *mem = NULL;
+    if (posix_memalign(&mem, align, n * sizeof(T)) != 0) {
+      fprintf(stderr, "slot_table: out of memory for %lu slots\n", (unsigned long)n);
+      abort();
+    }
+    T *slots = (T *)mem;
+    for (size_t i = 0; i < n; i++)
+      new (&slots[i]) T();
+    return slots;
+  }
+
+public:
+  slot_table() {
+    memset(segments, 0, sizeof(segments));
+    high_water = 0;
+  }
+
+  ~slot_table() {
+    for (unsigned seg = 0; seg < NUM_SEGMENTS; seg++) {
+      if (!segments[seg])
+        continue;
+      for (size_t i = 0; i < segment_size(seg); i++)
+        segments[seg][i].~T();
+      free(segments[seg]);
+    }
+  }
+
+  /** The slot of @idx, which must have been created by ensure(). **/
+  inline T &operator[](int idx) {
+    unsigned off;
+    unsigned seg = locate((unsigned)idx, off);
+    assert(segments[seg] && "slot not created yet");
+    return segments[seg][off];
+  }
+
+  /** Create the slot of @idx if it does not exist yet, and return it. **/
+  inline T &ensure(int idx) {
+    assert(idx >= 0);
+    unsigned off;
+    unsigned seg = locate((unsigned)idx, off);
+    assert(seg < NUM_SEGMENTS && "too many threads");
+    if (!segments[seg])
+      segments[seg] = alloc_segment(seg);
+    if (idx >= high_water)
+      high_water = idx + 1;
+    return segments[seg][off];
+  }
+
+  /** Whether the slot of @idx exists. **/
+  inline bool has(int idx) {
+    if (idx < 0 || idx >= high_water)
+      return false;
+    unsigned off;
+    return segments[locate((unsigned)idx, off)] != NULL;
+  }
+
+  /** 1 + the largest index ever created; slots at or beyond it are all untouched. **/
+  inline int size() {
+    return high_water;
+  }
+};
+}
+#endif
@@ -0,0 +1,281 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __TERN_COMMON_RUNTIME_SYNC_TABLE_H
+#define __TERN_COMMON_RUNTIME_SYNC_TABLE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <vector>
+#include "run-queue.h"
+
+namespace tern {
+
+/** The FIFO of threads waiting on one channel, threaded through the prev/next links of their
+run queue elements (see wait_queue). A list can also be kept by its owner outside the sync
+table; its channel is then the list itself. **/
+struct wait_list_t {
+  void *chan;
+  run_queue::runq_elem *head;
+  run_queue::runq_elem *tail;
+  size_t num_waiters;
+  size_t num_timed;
+  unsigned long nwaits; // number of threads ever queued on the list
+
+  wait_list_t() {
+    chan = this;
+    nwaits = 0;
+    clear();
+  }
+  /** Forget all waiters, e.g., in the child process after fork(). **/
+  void clear() {
+    head = tail = NULL;
+    num_waiters = num_timed = 0;
+  }
+};
+
+struct barrier_t {
+  unsigned count;    // barrier count
+  unsigned narrived; // number of threads arrived at the barrier
+};
+struct ref_cnt_barrier_t {
+  unsigned count;    // barrier count
+  unsigned nactive;  // number of threads in the linup region (between lineup_starnt and lineup_end).
+  unsigned timeout;  // Number of turns that an operation (at most) has to block.
+  enum PHASE {ARRIVING, LEAVING}; // ARRIVING: we have to wait up to "count" threads arrive or timeout.
+                              // LEAVING: timeout has happened or all threads have arrived.
+  PHASE phase;
+  long nSuccess;
+  long nTimeout;
+  void setArriving() {phase = ARRIVING;}
+  void setLeaving() {phase = LEAVING;}
+  bool isArriving() {return phase == ARRIVING;}
+  bool isLeaving() {return phase == LEAVING;}
+};
+
+/// a pthread mutex as seen by the mutex engine (options::mutex_engine)
+struct det_mutex_t {
+  int owner;       // tid of the owner, or Scheduler::InvalidTid if unlocked
+  unsigned count;  // lock count of a recursive mutex
+  int kind;        // PTHREAD_MUTEX_NORMAL, _RECURSIVE, _ERRORCHECK or _DEFAULT
+};
+
+/// a pthread rwlock as seen by the rwlock engine (options::rwlock_engine).
+/// Waiting readers wait on &@nreaders and waiting writers on &@writer.
+struct det_rwlock_t {
+  int writer;         // tid of the writer holding the lock, or Scheduler::InvalidTid
+  unsigned nreaders;  // number of readers holding the lock
+};
+
+/// a semaphore as seen by the semaphore engine (options::sem_engine).
+/// Waiters wait on the sem_t.
+struct det_sem_t {
+  unsigned value;
+};
+
+/** Everything the runtime keeps about one sync object: the threads waiting on it, the state
+of its kind, the turn shard it belongs to, which thread may use it without the turn, and
+statistics. A record whose @kind is NONE only lives while threads wait on it, it belongs to a
+shard or a thread has touched it with private_sync_fast_path. Only the thread holding the turn
+may touch records. **/
+struct sync_obj_t {
+  enum KIND {NONE, BARRIER, LINEUP, MUTEX, RWLOCK, SEM, COND};
+  enum {UNSEEN = -2, SHARED = -1}; // @private_owner if it is no thread
+
+  void *addr;           // the sync object, or the opaque id of a lineup
+  KIND kind;
+  bool keep;            // keep the record for its statistics (see sync_table::keep_unused())
+  int shard;            // the turn shard the object belongs to (see ShardScheduler), or -1
+  int private_owner;    // the only thread that has touched the object (see
+                        // RecorderRT::privateSyncTouch()), SHARED or UNSEEN
+  wait_list_t waiters;  // threads waiting on @addr
+  union {
+    barrier_t barrier;
+    ref_cnt_barrier_t lineup;
+    det_mutex_t mutex;
+    det_rwlock_t rwlock;
+    det_sem_t sem;
+    pthread_mutex_t *cond_mutex; // the mutex the last waiter of a cond var passed
+  };
+  sync_obj_t *free_next;
+
+  void reset(void *a) {
+    addr = a;
+    kind = NONE;
+    keep = false;
+    shard = -1;
+    private_owner = UNSEEN;
+    waiters.chan = a;
+    waiters.clear();
+    waiters.nwaits = 0;
+    free_next = NULL;
+  }
+};
+
+/** The side table of sync objects, keyed by address. Lookups probe a flat, power-of-two
+array of record pointers (open addressing with linear probing, at most 3/4 full, and
+backward-shift deletion, so there are no tombstones). Records are allocated from slabs and
+recycled, so they never move: the runtime may keep pointers to them (e.g., inside a
+pthread_barrier_t) until they are erased. **/
+class sync_table {
+  enum {SLAB_SIZE = 64, MIN_CAPACITY = 64};
+
+  sync_obj_t **slots;
+  size_t capacity;
+  size_t num_objs;
+  std::vector<sync_obj_t*> slabs;
+  sync_obj_t *free_objs;
+  bool keep_all;
+
+  static inline size_t hash(void *addr) {
+    uint64_t x = (uintptr_t)addr;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return (size_t)x;
+  }
+
+  inline size_t home(void *addr) const {
+    return hash(addr) & (capacity - 1);
+  }
+
+  void grow() {
+    sync_obj_t **old = slots;
+    size_t old_capacity = capacity;
+    capacity *= 2;
+    slots = new sync_obj_t*[capacity];
+    memset(slots, 0, capacity * sizeof(sync_obj_t*));
+    for (size_t i = 0; i < old_capacity; i++) {
+      if (!old[i])
+        continue;
+      size_t j = home(old[i]->addr);
+      while (slots[j])
+        j = (j + 1) & (capacity - 1);
+      slots[j] = old[i];
+    }
+    delete [] old;
+  }
+
+  sync_obj_t *alloc() {
+    if (!free_objs) {
+      sync_obj_t *slab = new sync_obj_t[SLAB_SIZE];
+      slabs.push_back(slab);
+      for (size_t i = 0; i < SLAB_SIZE; i++) {
+        slab[i].free_next = free_objs;
+        free_objs = &slab[i];
+      }
+    }
+    sync_obj_t *obj = free_objs;
+    free_objs = obj->free_next;
+    return obj;
+  }
+
+public:
+  sync_table() {
+    capacity = MIN_CAPACITY;
+    slots = new sync_obj_t*[capacity];
+    memset(slots, 0, capacity * sizeof(sync_obj_t*));
+    num_objs = 0;
+    free_objs = NULL;
+    keep_all = false;
+  }
+
+  /** Keep the records created from now on even when unused, for their statistics. **/
+  inline void keep_unused(bool keep) {
+    keep_all = keep;
+  }
+
+  ~sync_table() {
+    delete [] slots;
+    for (size_t i = 0; i < slabs.size(); i++)
+      delete [] slabs[i];
+  }
+
+  /** The record of @addr, or NULL if there is none. **/
+  inline sync_obj_t *find(void *addr) {
+    for (size_t i = home(addr); slots[i]; i = (i + 1) & (capacity - 1))
+      if (slots[i]->addr == addr)
+        return slots[i];
+    return NULL;
+  }
+
+  /** The record of @addr, created with kind NONE if there is none. **/
+  inline sync_obj_t *find_or_create(void *addr) {
+    size_t i = home(addr);
+    for (; slots[i]; i = (i + 1) & (capacity - 1))
+      if (slots[i]->addr == addr)
+        return slots[i];
+    sync_obj_t *obj = alloc();
+    obj->reset(addr);
+    obj->keep = keep_all;
+    if ((num_objs + 1) * 4 > capacity * 3) {
+      grow();
+      for (i = home(addr); slots[i]; i = (i + 1) & (capacity - 1))
+        ;
+    }
+    slots[i] = obj;
+    num_objs++;
+    return obj;
+  }
+
+  /** Remove @obj, which must be in the table, and recycle it. Entries after it in its probe
+  run move back to fill the hole, so later lookups never cross an empty slot. **/
+  inline void erase(sync_obj_t *obj) {
+    size_t mask = capacity - 1;
+    size_t i = home(obj->addr);
+    while (slots[i] != obj)
+      i = (i + 1) & mask;
+    slots[i] = NULL;
+    for (size_t j = (i + 1) & mask; slots[j]; j = (j + 1) & mask) {
+      size_t k = home(slots[j]->addr);
+      // leave slots[j] if its home lies cyclically in (i, j]
+      if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+        continue;
+      slots[i] = slots[j];
+      slots[j] = NULL;
+      i = j;
+    }
+    num_objs--;
+    obj->free_next = free_objs;
+    free_objs = obj;
+  }
+
+  /** Erase @obj if nothing uses it: no thread waits on it and it holds no runtime state. **/
+  inline void release(sync_obj_t *obj) {
+    if (obj->waiters.num_waiters == 0 && obj->kind == sync_obj_t::NONE && obj->shard < 0 &&
+        obj->private_owner == sync_obj_t::UNSEEN && !obj->keep)
+      erase(obj);
+  }
+
+  inline size_t size() {
+    return num_objs;
+  }
+
+  /** Slot @i of the table, NULL if empty; for walking all records with slot_count(). Erasing
+  the record in slot @i may move another record into it. **/
+  inline sync_obj_t *slot(size_t i) {
+    return slots[i];
+  }
+
+  inline size_t slot_count() {
+    return capacity;
+  }
+};
+}
+#endif
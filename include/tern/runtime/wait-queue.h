@@ -0,0 +1,352 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __TERN_COMMON_RUNTIME_WAIT_QUEUE_H
+#define __TERN_COMMON_RUNTIME_WAIT_QUEUE_H
+
+#include <stdint.h>
+#include <limits.h>
+#include <list>
+#include <vector>
+#include <algorithm>
+#include "run-queue.h"
+#include "sync-table.h"
+
+namespace tern {
+/** Wait queues of blocked threads, keyed by the channel (the address of a sync var) they wait on.
+
+Each channel has its own FIFO of waiters, kept in the channel's record in the sync table (see
+sync-table.h), so a signal only looks at the threads waiting on that channel, and a signal on
+a channel nobody waits on costs one table lookup. The runtime finds its own per-object state
+in the same records. The FIFOs are threaded through the prev/next links of the threads' run
+queue elements (a thread is never in the run queue and in a wait queue at the same time), so a
+broadcast can splice a whole FIFO onto the run queue at once. Threads waiting with a timeout
+are also kept in a binary min-heap ordered by (timeout turn, order they started waiting), so
+checking whether any timeout is due and finding the next timeout are O(1), and expiring a
+waiter is O(log n).
+
+Like run_queue, this class does not synchronize itself; only the thread holding the turn may
+touch it. **/
+class wait_queue {
+public:
+  typedef run_queue::runq_elem elem_t;
+  typedef wait_list_t list_t;
+
+  enum {NO_TIMEOUT = UINT_MAX}; // NO_TIMEOUT equals Scheduler::FOREVER
+
+private:
+  sync_table objs;
+  std::vector<elem_t*> timed_heap;
+  unsigned long timed_seq; // tie breaker of equal timeouts: FIFO
+  size_t num_elements;
+
+  /** The record of @chan if it has waiters, else NULL. **/
+  inline sync_obj_t *find(void *chan) {
+    sync_obj_t *o = objs.find(chan);
+    return o && o->waiters.num_waiters ? o : NULL;
+  }
+
+  /** Drop the record @o of a plain channel once nobody waits on it. **/
+  inline void release(sync_obj_t *o) {
+    objs.release(o);
+  }
+
+  static inline bool heap_less(elem_t *a, elem_t *b) {
+    if (a->wait_timeout != b->wait_timeout)
+      return a->wait_timeout < b->wait_timeout;
+    return a->wait_seq < b->wait_seq;
+  }
+
+  static inline bool seq_less(elem_t *a, elem_t *b) {
+    return a->wait_seq < b->wait_seq;
+  }
+
+  inline void heap_set(size_t i, elem_t *elem) {
+    timed_heap[i] = elem;
+    elem->heap_index = (int)i;
+  }
+
+  inline void heap_sift_up(size_t i) {
+    elem_t *elem = timed_heap[i];
+    while (i > 0) {
+      size_t parent = (i - 1) / 2;
+      if (!heap_less(elem, timed_heap[parent]))
+        break;
+      heap_set(i, timed_heap[parent]);
+      i = parent;
+    }
+    heap_set(i, elem);
+  }
+
+  inline void heap_sift_down(size_t i) {
+    size_t n = timed_heap.size();
+    elem_t *elem = timed_heap[i];
+    while (true) {
+      size_t child = 2 * i + 1;
+      if (child >= n)
+        break;
+      if (child + 1 < n && heap_less(timed_heap[child + 1], timed_heap[child]))
+        child++;
+      if (!heap_less(timed_heap[child], elem))
+        break;
+      heap_set(i, timed_heap[child]);
+      i = child;
+    }
+    heap_set(i, elem);
+  }
+
+  inline void heap_insert(elem_t *elem) {
+    elem->wait_seq = timed_seq++;
+    timed_heap.push_back(elem);
+    heap_sift_up(timed_heap.size() - 1);
+  }
+
+  inline void heap_remove(elem_t *elem) {
+    size_t i = (size_t)elem->heap_index;
+    ASSERT(elem->heap_index >= 0 && timed_heap[i] == elem);
+    elem_t *last = timed_heap.back();
+    timed_heap.pop_back();
+    elem->heap_index = -1;
+    if (last == elem)
+      return;
+    heap_set(i, last);
+    if (i > 0 && heap_less(last, timed_heap[(i - 1) / 2]))
+      heap_sift_up(i);
+    else
+      heap_sift_down(i);
+  }
+
+  /** Unlink @elem from the FIFO of @c; does not release @c. **/
+  inline void unlink(list_t *c, elem_t *elem) {
+    if (elem->prev)
+      elem->prev->next = elem->next;
+    else
+      c->head = elem->next;
+    if (elem->next)
+      elem->next->prev = elem->prev;
+    else
+      c->tail = elem->prev;
+    elem->prev = elem->next = NULL;
+    c->num_waiters--;
+    if (elem->wait_timeout != NO_TIMEOUT) {
+      c->num_timed--;
+      heap_remove(elem);
+    }
+    elem->wait_chan = NULL;
+    num_elements--;
+  }
+
+  /** Append @elem to the FIFO of @c. **/
+  inline void link(list_t *c, elem_t *elem, unsigned timeout) {
+    elem->wait_chan = c->chan;
+    elem->wait_timeout = timeout;
+    elem->next = NULL;
+    elem->prev = c->tail;
+    if (c->tail)
+      c->tail->next = elem;
+    else
+      c->head = elem;
+    c->tail = elem;
+    c->num_waiters++;
+    c->nwaits++;
+    if (timeout != NO_TIMEOUT) {
+      c->num_timed++;
+      heap_insert(elem);
+    }
+    num_elements++;
+  }
+
+public:
+  wait_queue() {
+    timed_seq = 0;
+    num_elements = 0;
+  }
+
+  /** The sync table holding the channels' records, shared with the runtime. **/
+  inline sync_table &objects() {
+    return objs;
+  }
+
+  inline bool empty() {
+    return num_elements == 0;
+  }
+
+  inline size_t size() {
+    return num_elements;
+  }
+
+  /** Whether any thread waits on @chan. **/
+  inline bool has_waiters(void *chan) {
+    return find(chan) != NULL;
+  }
+
+  /** Number of threads waiting on @chan. **/
+  inline size_t num_waiters(void *chan) {
+    sync_obj_t *o = objs.find(chan);
+    return o ? o->waiters.num_waiters : 0;
+  }
+
+  /** Block @elem on @chan until @timeout (NO_TIMEOUT for none). @elem must not be in the run queue. **/
+  inline void push_back(elem_t *elem, void *chan, unsigned timeout) {
+    // run_queue::in() tells the two kinds of list apart by the links alone
+    assert(elem->prev == NULL && elem->next == NULL);
+    sync_obj_t *o = objs.find_or_create(chan);
+    link(&o->waiters, elem, timeout);
+  }
+
+  /** Block @elem on @l: the waiters of a record the caller has already looked up, or a list
+  kept by its owner outside the table (untimed waiters only). **/
+  inline void push_back(elem_t *elem, list_t &l, unsigned timeout = NO_TIMEOUT) {
+    assert(elem->prev == NULL && elem->next == NULL); // see above
+    ASSERT(timeout == NO_TIMEOUT || l.chan != &l);
+    link(&l, elem, timeout);
+  }
+
+  /** Remove @elem, which must be waiting, from its channel (e.g., on timeout). **/
+  inline void erase(elem_t *elem) {
+    sync_obj_t *o = find(elem->wait_chan);
+    ASSERT(o);
+    unlink(&o->waiters, elem);
+    release(o);
+  }
+
+  /** Remove and return the first waiter on @chan, or NULL if there is none. **/
+  inline elem_t *pop_front(void *chan) {
+    sync_obj_t *o = find(chan);
+    if (!o)
+      return NULL;
+    elem_t *elem = o->waiters.head;
+    unlink(&o->waiters, elem);
+    release(o);
+    return elem;
+  }
+
+  /** Append all the waiters on @chan, in FIFO order, to @runq. Return the number of threads
+  moved. Untimed waiters are moved with a single splice; they keep their stale @wait_chan
+  until they return from waiting. **/
+  inline size_t pop_all(void *chan, run_queue &runq) {
+    sync_obj_t *o = find(chan);
+    if (!o)
+      return 0;
+    size_t n = pop_all(o->waiters, runq);
+    release(o);
+    return n;
+  }
+
+  /** Append all the waiters on @l, in FIFO order, to @runq, and return their number. **/
+  inline size_t pop_all(list_t &l, run_queue &runq) {
+    size_t n = l.num_waiters;
+    if (n == 0)
+      return 0;
+    if (l.num_timed > 0) {
+      for (elem_t *elem = l.head; elem; elem = elem->next)
+        if (elem->wait_timeout != NO_TIMEOUT) {
+          heap_remove(elem);
+          elem->wait_timeout = NO_TIMEOUT;
+        }
+    }
+    runq.splice_back(l.head, l.tail, n);
+    num_elements -= n;
+    l.clear();
+    return n;
+  }
+
+  /** Move the first waiter on @from (all of them if @all), in FIFO order, to the tail of @to
+  without waking them up, e.g., signaled cond var waiters that still have to get the mutex.
+  Timeouts are dropped. Return the number of threads moved. **/
+  inline size_t transfer(void *from, void *to, bool all) {
+    sync_obj_t *c = find(from);
+    if (!c || from == to)
+      return 0;
+    sync_obj_t *d = objs.find_or_create(to);
+    size_t n = 0;
+    do {
+      elem_t *elem = c->waiters.head;
+      unlink(&c->waiters, elem);
+      link(&d->waiters, elem, NO_TIMEOUT);
+      n++;
+    } while (all && c->waiters.head);
+    // @d may have moved @c's record only if @c was empty; it is not
+    release(c);
+    return n;
+  }
+
+  /** Whether @elem is blocked in this queue. **/
+  inline bool in(elem_t *elem) {
+    if (elem->wait_chan == NULL)
+      return false;
+    sync_obj_t *o = find(elem->wait_chan);
+    if (!o)
+      return false;
+    for (elem_t *e = o->waiters.head; e; e = e->next)
+      if (e == elem)
+        return true;
+    return false;
+  }
+
+  /** The earliest timeout of all waiters, or NO_TIMEOUT if none waits with a timeout. **/
+  inline unsigned next_timeout() {
+    return timed_heap.empty() ? (unsigned)NO_TIMEOUT : timed_heap[0]->wait_timeout;
+  }
+
+  /** Remove all waiters whose timeout is before @now from their channels and append them to
+  @expired in the order they started waiting. Costs O(1) if no timeout is due. **/
+  inline size_t pop_expired(unsigned now, std::vector<elem_t*> &expired) {
+    size_t first = expired.size();
+    while (!timed_heap.empty() && timed_heap[0]->wait_timeout < now) {
+      elem_t *elem = timed_heap[0];
+      expired.push_back(elem);
+      erase(elem);
+    }
+    size_t n = expired.size() - first;
+    if (n > 1)
+      std::sort(expired.begin() + first, expired.end(), seq_less);
+    return n;
+  }
+
+  /** Append the tids of all waiters to @tids (for debugging). **/
+  void get_tids(std::list<int> &tids) {
+    for (size_t i = 0; i < objs.slot_count(); i++)
+      if (sync_obj_t *o = objs.slot(i))
+        for (elem_t *e = o->waiters.head; e; e = e->next)
+          tids.push_back(e->tid);
+  }
+
+  /** Drop all waiters, e.g., in the child process after fork(). The elements themselves
+  are owned by run_queue; the records the runtime owns stay in the table. **/
+  inline void clear() {
+    for (size_t i = 0; i < objs.slot_count(); ) {
+      sync_obj_t *o = objs.slot(i);
+      if (!o) {
+        i++;
+        continue;
+      }
+      o->waiters.clear();
+      if (o->kind == sync_obj_t::NONE && !o->keep)
+        objs.erase(o); // may shift another record into slot @i
+      else
+        i++;
+    }
+    for (size_t i = 0; i < timed_heap.size(); i++)
+      timed_heap[i]->heap_index = -1;
+    timed_heap.clear();
+    num_elements = 0;
+  }
+};
+}
+#endif
@@ -50,8 +50,8 @@ DEF(pthread_rwlock_wrlock, Synchronization, int, pthread_rwlock_t *rwlock)
 DEF(pthread_rwlock_unlock, Synchronization, int, pthread_rwlock_t *rwlock)
 DEF(pthread_rwlock_destroy, Synchronization, int, pthread_rwlock_t *rwlock)
 DEF(pthread_rwlock_init, Synchronization, int, pthread_rwlock_t * rwlock, const pthread_rwlockattr_t * attr) 
-//DEF(pthread_rwlock_timedrdlock, Synchronization, int, pthread_rwlock_t * rwlock, const struct timespec * abs_timeout)
-//DEF(pthread_rwlock_timedwrlock, Synchronization, int, pthread_rwlock_t * rwlock, const struct timespec * abs_timeout)
+DEF(pthread_rwlock_timedrdlock, Synchronization, int, pthread_rwlock_t * rwlock, const struct timespec * abs_timeout)
+DEF(pthread_rwlock_timedwrlock, Synchronization, int, pthread_rwlock_t * rwlock, const struct timespec * abs_timeout)
 
 
 // DEF(pthread_cond_init,      Synchronization, int, pthread_cond_t *cond, pthread_condattr_t*attr)
@@ -68,7 +68,8 @@ DEF(sem_post,               Synchronization, int, sem_t *sem)
 DEF(sem_wait,               Synchronization, int, sem_t *sem)
 DEF(sem_trywait,            Synchronization, int, sem_t *sem)
 DEF(sem_timedwait,          Synchronization, int, sem_t *sem, const struct timespec *abs_timeout)
-// DEF(sem_destroy,            Synchronization, int, sem_t *sem)
+DEF(sem_getvalue,           Synchronization, int, sem_t *sem, int *sval)
+DEF(sem_destroy,            Synchronization, int, sem_t *sem)
 
 /* socket functions and file functions */
 //	blockings: accept, connect, recv, recvfrom, recvmsg, read, select 
@@ -172,4 +173,6 @@ DEFTERNUSER(tern_non_det_end)
 DEFTERNAUTO(tern_fix_up)
 DEFTERNAUTO(tern_fix_down)
 DEFTERNAUTO(tern_idle)
+DEFTERNUSER(tern_set_domain)
+DEFTERNAUTO(tern_preempt)
 
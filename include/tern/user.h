@@ -56,6 +56,14 @@ extern "C" {
   void tern_set_base_timespec(struct timespec *ts);
   void tern_set_base_timeval(struct timeval *tv);
 
+  /// Move the calling thread to scheduling domain @domain (see turn_domains
+  /// in default.options). Threads it creates afterwards start there too.
+  void tern_set_domain(int domain);
+
+  /// Called on each loop back-edge @id by programs instrumented with
+  /// eval/find-hotspot; feeds the logical clocks of clock_scheduler.
+  int backedge_stat(int id);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,232 @@
+/* Copyright (c) 2013,  Regents of the Columbia University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "tern/runtime/clock-scheduler.h"
+#include <cstdio>
+#include <sched.h>
+#include "tern/options.h"
+
+using namespace std;
+using namespace tern;
+
+//#define _DEBUG_CLOCK
+
+#ifdef _DEBUG_CLOCK
+#  define dprintf(fmt...) do {                   \
+     fprintf(stderr, "[%d] ", self());            \
+     fprintf(stderr, fmt);                       \
+     fflush(stderr);                             \
+   } while(0)
+#else
+#  define dprintf(fmt...) ;
+#endif
+
+ClockScheduler::ClockScheduler()
+{
+  // RRScheduler() passed the main thread the first turn; here it asks for
+  // it like any other thread
+  waits[MainThreadTid].wait();
+  runq.get_my_elem(MainThreadTid)->status = run_queue::RUNNABLE;
+  thd_clock_t &c = clocks.ensure(MainThreadTid);
+  c.clock = 0;
+  c.state = ACTIVE;
+  c.must_sleep = false;
+  holder = InvalidTid;
+  clock_floor = 0;
+}
+
+ClockScheduler::~ClockScheduler() {}
+
+//@before with turn
+//@after with turn
+bool ClockScheduler::isMin(int tid)
+{
+  unsigned long long mine = clocks[tid].clock;
+  for (run_queue::iterator th = runq.begin(); th != runq.end(); ++th) {
+    if (*th == tid)
+      continue;
+    unsigned long long other = clocks[*th].clock;
+    if (other < mine || (other == mine && *th < tid))
+      return false;
+  }
+  return true;
+}
+
+/** Threads get back on @runq with the turn held (signal(), timeouts,
+check_wakeup()), and count from then on. A waiting thread starts from
+@waker_clock if behind, as it could not have got there before its waker;
+a thread back from a blocking call from the clock of the latest turn. **/
+//@before with turn
+//@after with turn
+void ClockScheduler::activate(unsigned long long waker_clock)
+{
+  for (run_queue::iterator th = runq.begin(); th != runq.end(); ++th) {
+    thd_clock_t &c = clocks[*th];
+    if (c.state == ACTIVE)
+      continue;
+    // a thread back from a blocking call may be ticking meanwhile; when it
+    // comes back is not deterministic anyway
+    unsigned long long from = (c.state == WAITING) ? waker_clock : clock_floor;
+    if (c.clock < from)
+      c.clock = from;
+    dprintf("ClockScheduler: %d is back at clock %llu\n", *th, c.clock);
+    if (c.state == WAITING)
+      waits[*th].post();
+    c.state = ACTIVE;
+  }
+}
+
+/** Poll until the turn is free and no other thread on @runq has a smaller
+(clock, tid). The check is repeated with the turn taken, when nobody can
+change @runq, and the clocks of the others can only grow from then on. **/
+//@before without turn
+//@after with turn
+void ClockScheduler::getTurn()
+{
+  int tid = self();
+  assert(tid>=0 && tid < Scheduler::nthread);
+  thd_clock_t &me = clocks[tid];
+  if (me.must_sleep) { // see next()
+    me.must_sleep = false;
+    waits[tid].wait();
+  }
+  while (true) {
+    if (holder == InvalidTid &&
+        __sync_bool_compare_and_swap(&holder, InvalidTid, tid)) {
+      if (me.state == BLOCKED) {
+        // back from a blocking call; nobody else may be there to take us
+        check_wakeup();
+        activate(me.clock);
+      }
+      if (me.state == ACTIVE && isMin(tid))
+        break;
+      __sync_synchronize();
+      holder = InvalidTid;
+    }
+    sched_yield();
+  }
+  run_queue::runq_elem *my = runq.get_my_elem(tid);
+  if (runq.front() != tid) {
+    runq.erase(run_queue::iterator(my));
+    runq.push_front(tid);
+  }
+  my->status = run_queue::RUNNING_REG;
+  dprintf("ClockScheduler: %d gets turn at clock %llu\n", tid, me.clock);
+}
+
+//@before with turn
+//@after without turn
+void ClockScheduler::putTurn(bool at_thread_end)
+{
+  int tid = self();
+  assert(tid>=0 && tid < Scheduler::nthread);
+  assert(tid == runq.front());
+  clocks[tid].clock++;
+  if (at_thread_end) {
+    signal((void*)pthread_self());
+    Parent::zombify(pthread_self());
+    clocks[tid].state = BLOCKED;
+    runq.pop_front();
+    dprintf("ClockScheduler: %d ends\n", tid);
+  }
+  next(at_thread_end, at_thread_end);
+}
+
+/// release the turn; with @hasPoppedFront, the holder has left @runq
+//@before with turn
+//@after without turn
+void ClockScheduler::next(bool at_thread_end, bool hasPoppedFront)
+{
+  int tid = self();
+  thd_clock_t &me = clocks[tid];
+  if (!hasPoppedFront)
+    runq.get_my_elem(tid)->status = run_queue::RUNNABLE;
+  else if (!at_thread_end && me.state == ACTIVE) {
+    // from waitOn(): sleep until whoever puts us back on @runq posts us
+    me.state = WAITING;
+    me.must_sleep = true;
+  }
+  check_wakeup();
+  if (runq.empty())
+    refillRunq(); // jumps to the next timeout if nothing else can run
+  if (me.clock > clock_floor)
+    clock_floor = me.clock;
+  activate(me.clock);
+  dprintf("ClockScheduler: %d puts turn at clock %llu\n", tid, me.clock);
+  __sync_synchronize();
+  holder = InvalidTid;
+}
+
+//@before without turn
+//@after without turn
+int ClockScheduler::block()
+{
+  getTurn();
+  int tid = self();
+  int ret = incTurnCount();
+  clocks[tid].clock++;
+  clocks[tid].state = BLOCKED;
+  runq.get_my_elem(tid)->status = run_queue::RUNNABLE;
+  runq.pop_front();
+  dprintf("ClockScheduler: %d blocks\n", tid);
+  next(false, true);
+  return ret;
+}
+
+/// a thread leaves @runq for a blocking call only with the turn, so that
+/// the others stop counting its clock at a deterministic point
+bool ClockScheduler::interProStart()
+{
+  return true;
+}
+
+/// back through wakeup() and check_wakeup()
+bool ClockScheduler::interProEnd()
+{
+  return true;
+}
+
+/// owner thread only
+void ClockScheduler::advanceClock(unsigned n)
+{
+  clocks[self()].clock += n;
+}
+
+//@before with turn
+//@after with turn
+void ClockScheduler::create(pthread_t new_th)
+{
+  Parent::create(new_th);
+  thd_clock_t &c = clocks.ensure(getTid(new_th));
+  c.clock = clocks[self()].clock + 1;
+  c.state = ACTIVE;
+  c.must_sleep = false;
+}
+
+/// the child runs the rest of fork() with the turn
+void ClockScheduler::childForkReturn()
+{
+  unsigned long long clock = clocks[self()].clock; // the forking thread's
+  Parent::childForkReturn();
+  thd_clock_t &c = clocks[MainThreadTid];
+  c.clock = clock;
+  c.state = ACTIVE;
+  c.must_sleep = false;
+  holder = MainThreadTid;
+  inter_pro_wakeup_head = NULL;
+}
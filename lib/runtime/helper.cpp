@@ -50,6 +50,7 @@ extern "C" {
     Another solution is to add a flag in schedule showing if it happens that 
     runq is empty and the global token is held by no one. And recover the global
     token when some thread comes back to runq from blocking function call. 
+    RRScheduler does this when launch_idle_thread is 0 (see parkToken()).
  */
 volatile int idle_done = 0;
 pthread_t idle_th;
@@ -293,6 +293,16 @@ int tern_sem_init(unsigned ins, sem_t *sem, int pshared, unsigned int value) {
   return ret;
 }
 
+int tern_sem_destroy(unsigned ins, sem_t *sem) {
+  int error = errno;
+  int ret;
+  Space::enterSys();
+  ret = Runtime::the->semDestroy(ins, error, sem);
+  Space::exitSys();
+  errno = error;
+  return ret;
+}
+
 int tern_sem_wait(unsigned ins, sem_t *sem) {
   int error = errno;
   int ret;
@@ -333,6 +343,16 @@ int tern_sem_post(unsigned ins, sem_t *sem) {
   return ret;
 }
 
+int tern_sem_getvalue(unsigned ins, sem_t *sem, int *sval) {
+  int error = errno;
+  int ret;
+  Space::enterSys();
+  ret = Runtime::the->semGetValue(ins, error, sem, sval);
+  Space::exitSys();
+  errno = error;
+  return ret;
+}
+
 void tern_lineup_init_real(long opaque_type, unsigned count, unsigned timeout_turns) {
   int error = errno;
   Space::enterSys();
@@ -397,6 +417,26 @@ void tern_set_base_time_real(struct timespec *ts) {
   errno = error;
 }
 
+/// on every loop back-edge, so Space::enterSys() only if the runtime is
+/// going to take the turn
+void tern_backedge_stat_real(int id) {
+  if (!Runtime::the->backEdge(id))
+    return;
+  int error = errno;
+  Space::enterSys();
+  Runtime::the->preempt(id);
+  Space::exitSys();
+  errno = error;
+}
+
+void tern_set_domain_real(int domain) {
+  int error = errno;
+  Space::enterSys();
+  Runtime::the->setDomain(domain);
+  Space::exitSys();
+  errno = error;
+}
+
 
 void tern_non_det_barrier_end_real(int bar_id, int cnt) {
   int error = errno;
@@ -1098,6 +1138,28 @@ int tern_pthread_rwlock_init(unsigned ins, pthread_rwlock_t *rwlock, const pthre
   return ret; 
 }
 
+int tern_pthread_rwlock_timedrdlock(unsigned ins, pthread_rwlock_t *rwlock, const struct timespec *abs_timeout) 
+{ 
+  int error = errno; 
+  int ret; 
+  Space::enterSys(); 
+  ret = Runtime::the->__pthread_rwlock_timedrdlock(ins, error, rwlock, abs_timeout); 
+  Space::exitSys(); 
+  errno = error; 
+  return ret; 
+}
+
+int tern_pthread_rwlock_timedwrlock(unsigned ins, pthread_rwlock_t *rwlock, const struct timespec *abs_timeout) 
+{ 
+  int error = errno; 
+  int ret; 
+  Space::enterSys(); 
+  ret = Runtime::the->__pthread_rwlock_timedwrlock(ins, error, rwlock, abs_timeout); 
+  Space::exitSys(); 
+  errno = error; 
+  return ret; 
+}
+
 void tern_print_runtime_stat()
 {
   Space::enterSys();
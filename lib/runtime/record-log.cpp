@@ -172,6 +172,8 @@ void TxtLogger::logSync(unsigned insid, unsigned short sync,
   case syncfunc::tern_lineup_start:
   case syncfunc::tern_lineup_end:
   case syncfunc::tern_lineup_destroy:
+  case syncfunc::tern_set_domain:
+  case syncfunc::tern_preempt:
     ouf << hex << " 0x" << va_arg(args, uint64_t) << dec;
     break;
 
@@ -183,9 +185,13 @@ void TxtLogger::logSync(unsigned insid, unsigned short sync,
   case syncfunc::pthread_mutex_trylock:
   case syncfunc::sem_trywait:
   case syncfunc::sem_timedwait:
+  case syncfunc::sem_getvalue:  //  sem, value
+  case syncfunc::sem_destroy:  //  sem, ret
   case syncfunc::pthread_rwlock_tryrdlock:  //  rwlock, ret
   case syncfunc::pthread_rwlock_trywrlock:
   case syncfunc::pthread_rwlock_unlock:  //  rwlock, ret
+  case syncfunc::pthread_rwlock_timedrdlock:  //  rwlock, ret
+  case syncfunc::pthread_rwlock_timedwrlock:
     {
       //  notice "<<" operator is expanded from right to left.
       uint64_t a = va_arg(args, uint64_t);
@@ -245,9 +251,9 @@ void TxtLogger::logSync(unsigned insid, unsigned short sync,
   ouf.flush();
 }
 
-TxtLogger::TxtLogger(int thid) {
+TxtLogger::TxtLogger(int thid, int gen) {
   char logFile[64];
-  getLogFilename(logFile, sizeof(logFile), thid, ".txt");
+  getLogFilename(logFile, sizeof(logFile), thid, ".txt", gen);
 
   tid = thid;
   ouf.open(logFile, ios::out|ios::trunc);
@@ -417,9 +423,9 @@ void BinLogger::logSync(unsigned insid, unsigned short sync,
   off += RECORD_SIZE;
 }
 
-BinLogger::BinLogger(int tid) {
+BinLogger::BinLogger(int tid, int gen) {
   char logFile[64];
-  getLogFilename(logFile, sizeof(logFile), tid, ".bin");
+  getLogFilename(logFile, sizeof(logFile), tid, ".bin", gen);
 
   foff = 0;
   fd = open(logFile, O_RDWR|O_CREAT, 0600);
@@ -576,6 +582,8 @@ void TestLogger::logSync(unsigned insid, unsigned short sync,
   case syncfunc::tern_lineup_start:
   case syncfunc::tern_lineup_end:
   case syncfunc::tern_lineup_destroy:
+  case syncfunc::tern_set_domain:
+  case syncfunc::tern_preempt:
     ouf << hex << " 0x" << va_arg(args, uint64_t) << dec;
     break;
 
@@ -587,9 +595,13 @@ void TestLogger::logSync(unsigned insid, unsigned short sync,
   case syncfunc::pthread_mutex_trylock:
   case syncfunc::sem_trywait:
   case syncfunc::sem_timedwait:
+  case syncfunc::sem_getvalue:  //  sem, value
+  case syncfunc::sem_destroy:  //  sem, ret
   case syncfunc::pthread_rwlock_tryrdlock:  //  rwlock, ret
   case syncfunc::pthread_rwlock_trywrlock:
   case syncfunc::pthread_rwlock_unlock:  //  rwlock, ret
+  case syncfunc::pthread_rwlock_timedrdlock:  //  rwlock, ret
+  case syncfunc::pthread_rwlock_timedwrlock:
     {
       //  notice "<<" operator is expanded from right to left.
       uint64_t a = va_arg(args, uint64_t);
@@ -654,9 +666,9 @@ void TestLogger::flush() {
   ouf.flush();
 }
 
-TestLogger::TestLogger(int thid) {
+TestLogger::TestLogger(int thid, int gen) {
   char logFile[64];
-  getLogFilename(logFile, sizeof(logFile), thid, ".txt");
+  getLogFilename(logFile, sizeof(logFile), thid, ".txt", gen);
 
   tid = thid;
   ouf.open(logFile, ios::out|ios::trunc);
@@ -668,14 +680,14 @@ TestLogger::~TestLogger()
   ouf.close();
 }
 
-void Logger::threadBegin(int tid) {
+void Logger::threadBegin(int tid, int gen) {
   if (options::log_sync) {
     if(options::log_type == "txt") {
-      the = new TxtLogger(tid);
+      the = new TxtLogger(tid, gen);
     } else if(options::log_type == "bin") {
-      the = new BinLogger(tid);
+      the = new BinLogger(tid, gen);
     } else if(options::log_type == "test") {
-      the = new TestLogger(tid);
+      the = new TestLogger(tid, gen);
     } else
       assert (0 && "unknown log_type");
 
@@ -54,12 +54,15 @@
 #include <execinfo.h>
 #include <time.h>
 #include <string.h>
+#include <stddef.h>
 #include <errno.h>
 #include <poll.h>
 #include <sched.h>
 #include "tern/runtime/record-log.h"
 #include "tern/runtime/record-runtime.h"
 #include "tern/runtime/record-scheduler.h"
+#include "tern/runtime/shard-scheduler.h"
+#include "tern/runtime/clock-scheduler.h"
 #include "signal.h"
 #include "helper.h"
 #include "tern/space.h"
@@ -143,6 +146,22 @@ deterministic physical time interval, so that this interval can be
 deterministically converted to logical time interval. **/
 static __thread timespec my_base_time = {0, 0};
 
+/** The thread-private sync objects of the calling thread, once it has any
+(see RecorderRT::privateSyncTouch()). **/
+static __thread private_syncs_t *my_private_syncs = NULL;
+/** Lock operations the calling thread did on its private objects since its
+last turn, counted against options::private_sync_turn_ops. **/
+static __thread unsigned my_nprivate_sync_ops = 0;
+
+/** The sync operations the calling thread ran without the turn since its
+last turn (see RecorderRT::deferSync()). **/
+static __thread deferred_sync_t my_deferred_syncs[MAX_DEFERRED_SYNCS];
+static __thread unsigned my_ndeferred_syncs = 0;
+
+/** Loop back-edges the calling thread ran since its last turn, counted
+against options::backedge_preempt (see RecorderRT::backEdge()). **/
+static __thread unsigned my_nbackedges = 0;
+
 timespec time_diff(const timespec &start, const timespec &end)
 {
   timespec tmp;
@@ -176,11 +195,60 @@ void check_options()
   if (!options::RR_ignore_rw_regular_file)
     fprintf(stderr, "WARNING: RR_ignore_rw_regular_file is off, and so we can have "
       "non-determinism on regular file I/O!!\n");
+  if (options::clock_scheduler) {
+    // the turn is not passed around (see clock-scheduler.h), and there is
+    // only one
+    if (options::private_sync_fast_path || options::turn_free_init ||
+        options::solo_fast_path || options::turn_quantum > 1 ||
+        options::turn_shards > 1 || options::turn_domains > 1 ||
+        options::enforce_non_det_annotations || options::enforce_non_det_clock_bound)
+      fprintf(stderr, "WARNING: clock_scheduler is on; turning off private_sync_fast_path, "
+        "turn_free_init, solo_fast_path, turn_quantum, turn_shards, turn_domains and the "
+        "non-det annotations.\n");
+    options::launch_idle_thread = 0;
+    options::private_sync_fast_path = 0;
+    options::turn_free_init = 0;
+    options::solo_fast_path = 0;
+    options::turn_quantum = 1;
+    options::turn_shards = 1;
+    options::turn_domains = 1;
+    options::enforce_non_det_annotations = 0;
+    options::enforce_non_det_clock_bound = 0;
+  }
+  if (options::turn_domains > 1)
+    options::turn_shards = options::turn_domains; // the domains are the shards
+  if (options::turn_shards > 1) {
+    // these assume a single turn (see default.options); the idle thread and
+    // wait morphing are on by default, so only the others are worth a warning
+    if (options::private_sync_fast_path || options::turn_free_init ||
+        options::solo_fast_path || options::turn_quantum > 1 ||
+        options::enforce_non_det_annotations || options::enforce_non_det_clock_bound)
+      fprintf(stderr, "WARNING: turn_shards is on; turning off private_sync_fast_path, "
+        "turn_free_init, solo_fast_path, turn_quantum and the non-det annotations.\n");
+    options::launch_idle_thread = 0;
+    options::private_sync_fast_path = 0;
+    options::turn_free_init = 0;
+    options::solo_fast_path = 0;
+    options::turn_quantum = 1;
+    options::cond_wait_morphing = 0;
+    options::enforce_non_det_annotations = 0;
+    options::enforce_non_det_clock_bound = 0;
+  }
+  if (options::prewake_depth > 2) {
+    // further threads would get the turn long after their spin runs out
+    fprintf(stderr, "WARNING: prewake_depth is %d; using 2.\n", options::prewake_depth);
+    options::prewake_depth = 2;
+  }
 }
 
 void InstallRuntime() {
   check_options();
-  Runtime::the = new RecorderRT<RRScheduler>;
+  if (options::clock_scheduler)
+    Runtime::the = new RecorderRT<ClockScheduler>;
+  else if (options::turn_shards > 1)
+    Runtime::the = new RecorderRT<ShardScheduler>;
+  else
+    Runtime::the = new RecorderRT<RRScheduler>;
 }
 
 template <typename _S>
@@ -206,6 +274,41 @@ void RecorderRT<_S>::syncSignal(void *chan, bool all) {
 #endif
 }
 
+template <typename _S>
+int RecorderRT<_S>::syncSignalFirst(void *chan) {
+  int tid = _S::signalFirst(chan);
+#ifdef XTERN_PLUS_DBUG
+  if (tid != Scheduler::InvalidTid) {
+    Runtime::__thread_active(_S::getPthreadTid(tid));
+    dprintf("Parrot pid %d self %u tid %d signals tid %d dbug active\n", 
+      getpid(), (unsigned)pthread_self(), _S::self(), tid);
+  }
+#endif
+  return tid;
+}
+
+template <typename _S>
+int RecorderRT<_S>::syncWaitList(wait_queue::list_t &l, unsigned timeout) {
+#ifdef XTERN_PLUS_DBUG
+    dprintf("Parrot pid %d, tid %d self %u dbug waiting...\n", getpid(), _S::self(), (unsigned)pthread_self());
+  Runtime::__thread_waiting();
+#endif
+  return _S::waitList(l, timeout);
+}
+
+template <typename _S>
+void RecorderRT<_S>::syncSignalList(wait_queue::list_t &l) {
+#ifdef XTERN_PLUS_DBUG
+  for (run_queue::runq_elem *elem = l.head; elem; elem = elem->next) {
+    pthread_t tid = _S::getPthreadTid(elem->tid);
+    Runtime::__thread_active(tid);
+    dprintf("Parrot pid %d self %u tid %d signals tid %d self %u dbug active\n", 
+      getpid(), (unsigned)pthread_self(), _S::self(), elem->tid, (unsigned)tid);
+  }
+#endif
+  _S::signalList(l);
+}
+
 template <typename _S>
 int RecorderRT<_S>::absTimeToTurn(const struct timespec *abstime)
 {
@@ -215,13 +318,6 @@ int RecorderRT<_S>::absTimeToTurn(const struct timespec *abstime)
 
 int time2turn(uint64_t nsec)
 {
-  if (!options::launch_idle_thread) {
-    fprintf(stderr, "WARN: converting phyiscal time to logical time \
-      without launcing idle thread. Please set 'launch_idle_thread' to 1 and then \
-      rerun.\n");
-    exit(1);
-  }
-
   const uint64_t MAX_REL = (1000000); // maximum number of turns to wait
 
   uint64_t ret64 = nsec / options::nanosec_per_turn;
@@ -267,6 +363,8 @@ void RecorderRT<_S>::progEnd(void) {
 template <typename _S>
 void RecorderRT<_S>::idle_sleep(void) {
   _S::getTurn();
+  if (options::idle_time_warp)
+    _S::warpToNextTimeout();
   int turn = _S::incTurnCount();
   assert(turn >= 0);
   timespec ts;
@@ -302,6 +400,8 @@ void RecorderRT<RecordSerializer>::idle_sleep(void) {
   if (options::enforce_non_det_annotations && inNonDet) { \
     return Runtime::__##sync_op(__VA_ARGS__); \
   } \
+  if (my_private_syncs) \
+    sharePrivateSyncs(); \
   if (_S::interProStart()) { \
     _S::block(); \
   } \
@@ -320,20 +420,34 @@ void RecorderRT<RecordSerializer>::idle_sleep(void) {
   errno = backup_errno;
   //fprintf(stderr, "\n\nBLOCK_TIMER_END ins %p, pid %d, self %u, tid %d, turnCount %u, function %s\n", (void *)ins, getpid(), (unsigned)pthread_self(), _S::self(), _S::turnCount, __FUNCTION__);
 
-#define SCHED_TIMER_START \
+#define SCHED_TIMER_START_COMMON(get_turn) \
   unsigned nturn; \
   if (options::enforce_non_det_annotations) \
      assert(!inNonDet); \
   timespec app_time = update_time(); \
   record_rdtsc_op("GET_TURN", "START", 2, NULL); \
-  _S::getTurn(); \
+  get_turn; \
   record_rdtsc_op("GET_TURN", "END", 2, NULL); \
   if (options::record_runtime_stat && pthread_self() != idle_th) \
      stat.nDetPthreadSyncOp++; \
+  if (my_ndeferred_syncs) \
+     catchUpSyncs(); \
+  if (nPrivateSyncRequests) \
+     promoteRequestedSyncs(); \
+  my_nbackedges = 0; \
+  if (options::record_runtime_stat) \
+     stat.nPrivateSyncOp += my_nprivate_sync_ops; \
+  my_nprivate_sync_ops = 0; \
   timespec sched_time = update_time();
   //if (_S::self() != 1)
     //fprintf(stderr, "\n\nSCHED_TIMER_START ins %p, pid %d, self %u, tid %d, turnCount %u, function %s\n", (void *)ins, getpid(), (unsigned)pthread_self(), _S::self(), _S::turnCount, __FUNCTION__);
 
+#define SCHED_TIMER_START SCHED_TIMER_START_COMMON(_S::getTurn())
+
+/// for an operation on the sync objects @obj and @obj2 (or NULL) only; see
+/// Serializer::getTurnOn()
+#define SCHED_TIMER_START_ON(obj, obj2) SCHED_TIMER_START_COMMON(_S::getTurnOn((obj), (obj2)))
+
 #define SCHED_TIMER_END_COMMON(syncop, ...) \
   int backup_errno = errno; \
   timespec syscall_time = update_time(); \
@@ -364,11 +478,40 @@ void RecorderRT<_S>::printStat(){
   // We must get turn, and print, and then put turn. This is a solid way of 
   // getting deterministic runtime stat.
   _S::getTurn();
-  if (options::record_runtime_stat)
+  if (options::record_runtime_stat) {
+    stat.nRelaySpins = stat.nRelayParks = 0;
+    stat.nRelaySpinNs = 0;
+    _S::getRelayStat(stat.nRelaySpins, stat.nRelayParks, stat.nRelaySpinNs);
     stat.print();
+    printSyncObjStat();
+  }
   _S::incTurnCount();
   _S::putTurn();
 }
+
+static bool more_waits(sync_obj_t *a, sync_obj_t *b) {
+  if (a->waiters.nwaits != b->waiters.nwaits)
+    return a->waiters.nwaits > b->waiters.nwaits;
+  return a->addr < b->addr;
+}
+
+template <typename _S>
+void RecorderRT<_S>::printSyncObjStat() {
+  static const char *kinds[] = {"none", "barrier", "lineup", "mutex", "rwlock", "sem", "cond"};
+  sync_table &objs = _S::syncObjects();
+  std::vector<sync_obj_t*> waited;
+  for (size_t i = 0; i < objs.slot_count(); i++)
+    if (objs.slot(i) && objs.slot(i)->waiters.nwaits > 0)
+      waited.push_back(objs.slot(i));
+  size_t n = std::min(waited.size(), (size_t)10);
+  std::partial_sort(waited.begin(), waited.begin() + n, waited.end(), more_waits);
+  std::cout << "SyncObjStat: " << objs.size() << " objects, "
+    << waited.size() << " waited on; most waited on:\n";
+  for (size_t i = 0; i < n; i++)
+    std::cout << "SYNC_OBJ: " << waited[i]->addr << "\t" << kinds[waited[i]->kind]
+      << "\t" << waited[i]->waiters.nwaits << "\n";
+  std::cout << "\n" << std::flush;
+}
   
 template <typename _S>
 void RecorderRT<_S>::threadBegin(void) {
@@ -382,10 +525,10 @@ void RecorderRT<_S>::threadBegin(void) {
   }
   assert(_S::self() != _S::InvalidTid);
 
-  SCHED_TIMER_START;
+  SCHED_TIMER_START_ON(NULL, NULL);
   
   app_time.tv_sec = app_time.tv_nsec = 0;
-  Logger::threadBegin(_S::self());
+  Logger::threadBegin(_S::self(), _S::generation(_S::self()));
 
   SCHED_TIMER_END(syncfunc::tern_thread_begin, (uint64_t)th);
 }
@@ -394,6 +537,7 @@ template <typename _S>
 void RecorderRT<_S>::threadEnd(unsigned ins) {
   SCHED_TIMER_START;
   pthread_t th = pthread_self();
+  promoteAllPrivateSyncs();
 
   SCHED_TIMER_THREAD_END(syncfunc::tern_thread_end, (uint64_t)th);
   
@@ -472,6 +616,10 @@ int RecorderRT<_S>::pthreadCreate(unsigned ins, int &error, pthread_t *thread,
   ret = __tern_pthread_create(thread, attr, thread_func, arg);
   assert(!ret && "failed sync calls are not yet supported!");
   _S::create(*thread);
+  int detach_state;
+  if (attr && !pthread_attr_getdetachstate(attr, &detach_state) &&
+      detach_state == PTHREAD_CREATE_DETACHED)
+    _S::detach(*thread);
 
   SCHED_TIMER_END(syncfunc::pthread_create, (uint64_t)*thread, (uint64_t) ret);
  
@@ -547,10 +695,14 @@ int RecorderRT<_S>::pthreadJoin(unsigned ins, int &error, pthread_t th, void **r
 }
 
 template <typename _S>
-int RecorderRT<_S>::__pthread_detach(unsigned insid, int &error, pthread_t th) {
-  BLOCK_TIMER_START(pthread_detach, insid, error, th);
-  int ret = Runtime::__pthread_detach(insid, error, th);
-  BLOCK_TIMER_END(syncfunc::pthread_detach, (uint64_t)ret);
+int RecorderRT<_S>::__pthread_detach(unsigned ins, int &error, pthread_t th) {
+  // pthread_detach() does not block, and the turn makes marking @th
+  // detached (and so when its tid is freed for reuse) deterministic.
+  SCHED_TIMER_START;
+  int ret = Runtime::__pthread_detach(ins, error, th);
+  if (!ret)
+    _S::detach(th);
+  SCHED_TIMER_END(syncfunc::pthread_detach, (uint64_t)th);
   return ret;
 }
 
@@ -565,10 +717,26 @@ int RecorderRT<_S>::pthreadMutexInit(unsigned ins, int &error, pthread_mutex_t *
     dprintf("Thread tid %d, self %u is calling non-det pthread_mutex_init.\n", _S::self(), (unsigned)pthread_self());
     return Runtime::__pthread_mutex_init(ins, error, mutex, mutexattr);
   }
+  if (turnFreeSync()) {
+    det_mutex_t *m = NULL;
+    // a new mutex at the address of one of our private mutexes stays private
+    bool mine = myPrivateSync(mutex, m);
+    errno = error;
+    ret = pthread_mutex_init(mutex, mutexattr);
+    error = errno;
+    if (m && !ret)
+      detMutexReset(*m, mutex);
+    deferSync(ins, syncfunc::pthread_mutex_init, mutex, ret, mine);
+    return ret;
+  }
   SCHED_TIMER_START;
+  privateSyncForget(mutex);
   errno = error;
   ret = pthread_mutex_init(mutex, mutexattr);
   error = errno;
+  if (useMutexEngine(mutex) && !ret)
+    if (sync_obj_t *obj = findSyncObj(mutex, sync_obj_t::MUTEX))
+      dropSyncObj(obj); // picks up the new kind on next use
   SCHED_TIMER_END(syncfunc::pthread_mutex_init, (uint64_t)ret);
   return ret;
 }
@@ -583,9 +751,34 @@ int RecorderRT<_S>::pthreadMutexDestroy(unsigned ins, int &error, pthread_mutex_
     add_non_det_var((void *)mutex);
     return Runtime::__pthread_mutex_destroy(ins, error, mutex);
   }
+  det_mutex_t *m = NULL;
+  // the engine state of a mutex other threads have touched needs the turn
+  if (turnFreeSync() && (myPrivateSync(mutex, m) || !useMutexEngine(mutex))) {
+    if (m && m->owner != Scheduler::InvalidTid)
+      ret = EBUSY;
+    else {
+      errno = error;
+      ret = pthread_mutex_destroy(mutex);
+      error = errno;
+    }
+    deferSync(ins, syncfunc::pthread_mutex_destroy, mutex, ret);
+    return ret;
+  }
   SCHED_TIMER_START;
+  _S::forgetSyncObj(mutex);
+  privateSyncForget(mutex);
   errno = error;
-  ret = pthread_mutex_destroy(mutex);
+  if (useMutexEngine(mutex)) {
+    sync_obj_t *obj = findSyncObj(mutex, sync_obj_t::MUTEX);
+    if (obj && obj->mutex.owner != Scheduler::InvalidTid)
+      ret = EBUSY;
+    else {
+      if (obj)
+        dropSyncObj(obj);
+      ret = pthread_mutex_destroy(mutex);
+    }
+  } else
+    ret = pthread_mutex_destroy(mutex);
   error = errno;
   SCHED_TIMER_END(syncfunc::pthread_mutex_destroy, (uint64_t)ret);
   return ret;
@@ -594,6 +787,8 @@ int RecorderRT<_S>::pthreadMutexDestroy(unsigned ins, int &error, pthread_mutex_
 template <typename _S>
 int RecorderRT<_S>::pthreadMutexLockHelper(pthread_mutex_t *mu, unsigned timeout) {
   int ret;
+  if (useMutexEngine(mu))
+    return detMutexLock(mu, timeout);
   while((ret=pthread_mutex_trylock(mu))) {
     assert(ret==EBUSY && "failed sync calls are not yet supported!");
     ret = syncWait(mu, timeout);
@@ -603,9 +798,444 @@ int RecorderRT<_S>::pthreadMutexLockHelper(pthread_mutex_t *mu, unsigned timeout
   return 0;
 }
 
+/// Wait morphing. A thread woken from pthread_cond_wait() must relock its
+/// mutex, and the signaler usually still holds it; woken the normal way,
+/// the thread runs only to fail trylock and block on the mutex. So while
+/// the mutex is held, move the woken threads to the mutex's wait queue
+/// directly; the unlocks wake them one at a time, in the order signaled.
+/// Both the check and the move are done with turn held, so they are
+/// deterministic. Only the mutex engine knows who holds a mutex (probing
+/// the real one would touch the application's mutex, and a recursive one
+/// held by the signaler looks free), so without it threads are woken the
+/// normal way.
+template <typename _S>
+void RecorderRT<_S>::condSignalHelper(pthread_cond_t *cv, bool all) {
+  if (options::cond_wait_morphing) {
+    if (sync_obj_t *obj = findSyncObj(cv, sync_obj_t::COND)) {
+      pthread_mutex_t *mu = obj->cond_mutex;
+      if (useMutexEngine(mu) && detMutex(mu).owner != Scheduler::InvalidTid &&
+          _S::transfer(cv, mu, all) > 0)
+        return;
+    }
+  }
+  syncSignal(cv, all);
+}
+
+/// The mutex engine. All mutex operations already run with turn held, so
+/// the runtime can track ownership itself instead of retrying
+/// pthread_mutex_trylock() around syncWait(): lock takes a free mutex or
+/// waits on it, and unlock gives the mutex to the first waiter before
+/// waking it up, so a woken thread never finds the mutex taken and no
+/// real pthread call is made.
+template <typename _S>
+bool RecorderRT<_S>::useMutexEngine(pthread_mutex_t *mu) {
+  // the idle thread waits on idle_cond with the real pthread_cond_wait()
+  return options::mutex_engine && mu != &idle_mutex;
+}
+
+template <typename _S>
+det_mutex_t &RecorderRT<_S>::detMutex(pthread_mutex_t *mu) {
+  sync_obj_t *obj = syncObj(mu);
+  det_mutex_t &m = obj->mutex;
+  if (obj->kind == sync_obj_t::MUTEX)
+    return m;
+  obj->kind = sync_obj_t::MUTEX;
+  detMutexReset(m, mu);
+  return m;
+}
+
+/// detMutexReset() reads the kind of a mutex from glibc's pthread_mutex_t,
+/// the only place a statically initialized mutex keeps it; glibc stores
+/// the PTHREAD_MUTEX_* type in the low two bits of __data.__kind.
+#ifndef __GLIBC__
+#error "the mutex engine reads the kind of a mutex from glibc's pthread_mutex_t"
+#endif
+BOOST_STATIC_ASSERT(PTHREAD_MUTEX_NORMAL == 0 && PTHREAD_MUTEX_RECURSIVE == 1 &&
+                    PTHREAD_MUTEX_ERRORCHECK == 2 && PTHREAD_MUTEX_ADAPTIVE_NP == 3);
+BOOST_STATIC_ASSERT(offsetof(pthread_mutex_t, __data.__kind) + sizeof(int)
+                    <= sizeof(pthread_mutex_t));
+
+template <typename _S>
+void RecorderRT<_S>::detMutexReset(det_mutex_t &m, pthread_mutex_t *mu) {
+  m.owner = Scheduler::InvalidTid;
+  m.count = 0;
+  // also covers static initializers such as PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP
+  m.kind = mu->__data.__kind & 3;
+}
+
+/// take @m if that needs no waiting; return 0 or the error lock()
+/// returns, or EBUSY if the caller has to wait
+template <typename _S>
+int RecorderRT<_S>::detMutexTake(det_mutex_t &m) {
+  int self = _S::self();
+  if (m.owner == Scheduler::InvalidTid) {
+    m.owner = self;
+    m.count = 1;
+    return 0;
+  }
+  if (m.owner == self) {
+    if (m.kind == PTHREAD_MUTEX_RECURSIVE) {
+      m.count++;
+      return 0;
+    }
+    if (m.kind == PTHREAD_MUTEX_ERRORCHECK)
+      return EDEADLK;
+    // a normal mutex self-deadlocks, as it does without the engine
+  }
+  return EBUSY;
+}
+
+/// drop one lock count of @m; return the error unlock() returns. If @m.count
+/// is 0 afterwards, the caller must pick the next owner
+template <typename _S>
+int RecorderRT<_S>::detMutexRelease(det_mutex_t &m) {
+  if (m.owner != _S::self()) {
+    if (m.kind == PTHREAD_MUTEX_RECURSIVE || m.kind == PTHREAD_MUTEX_ERRORCHECK)
+      return EPERM;
+    // like glibc, let anyone unlock a normal mutex
+    if (m.owner == Scheduler::InvalidTid) {
+      m.count = 0;
+      return 0;
+    }
+    m.count = 1;
+  }
+  m.count--;
+  return 0;
+}
+
+template <typename _S>
+int RecorderRT<_S>::detMutexLock(pthread_mutex_t *mu, unsigned timeout) {
+  det_mutex_t &m = detMutex(mu);
+  int ret = detMutexTake(m);
+  if (ret != EBUSY)
+    return ret;
+  ret = syncWait(mu, timeout);
+  if (ret == ETIMEDOUT)
+    return ETIMEDOUT;
+  assert(m.owner == _S::self() && "unlock must hand the mutex to the thread it wakes");
+  return 0;
+}
+
+template <typename _S>
+int RecorderRT<_S>::detMutexTryLock(pthread_mutex_t *mu) {
+  int ret = detMutexTake(detMutex(mu));
+  return ret == EDEADLK ? EBUSY : ret;
+}
+
+template <typename _S>
+int RecorderRT<_S>::detMutexUnlock(pthread_mutex_t *mu) {
+  det_mutex_t &m = detMutex(mu);
+  int ret = detMutexRelease(m);
+  if (ret || m.count > 0)
+    return ret;
+  m.owner = syncSignalFirst(mu);
+  if (m.owner != Scheduler::InvalidTid)
+    m.count = 1;
+  return 0;
+}
+
+/// The lock operations of the owner of a private mutex. Nobody else can
+/// reach the mutex, so the real pthread call (or the engine state) needs
+/// no turn; whether an operation comes here depends only on what the
+/// calling thread did with turn held, so the schedule stays deterministic.
+/// Every private_sync_turn_ops operations the owner takes a turn anyway,
+/// so a thread asking for one of its objects (privateSyncTouch()) does not
+/// wait forever for an owner that only uses private objects.
+template <typename _S>
+bool RecorderRT<_S>::privateMutexOp(unsigned ins, int &error, pthread_mutex_t *mu, int op, int &ret) {
+  private_syncs_t *mine = my_private_syncs;
+  if (!mine)
+    return false;
+  std::tr1::unordered_map<void*, det_mutex_t*>::iterator it = mine->objs.find(mu);
+  if (it == mine->objs.end())
+    return false;
+  if (my_nprivate_sync_ops >= (unsigned)options::private_sync_turn_ops) {
+    preempt(-1); // shares the requested objects, and resets the count
+    it = mine->objs.find(mu);
+    if (it == mine->objs.end())
+      return false;
+  }
+  det_mutex_t *m = it->second;
+  if (!m) {
+    switch (op) {
+    case PRIVATE_LOCK:
+      ret = Runtime::__pthread_mutex_lock(ins, error, mu);
+      break;
+    case PRIVATE_TRYLOCK:
+      errno = error;
+      ret = pthread_mutex_trylock(mu);
+      error = errno;
+      break;
+    default:
+      ret = Runtime::__pthread_mutex_unlock(ins, error, mu);
+    }
+  } else if (op == PRIVATE_UNLOCK) {
+    ret = detMutexRelease(*m);
+    if (!ret && m->count == 0)
+      m->owner = Scheduler::InvalidTid; // nobody else can wait on it
+  } else {
+    ret = detMutexTake(*m);
+    if (ret == EBUSY && op == PRIVATE_LOCK)
+      return false; // self-deadlock, in the scheduler as usual
+    if (ret == EDEADLK && op == PRIVATE_TRYLOCK)
+      ret = EBUSY;
+  }
+  my_nprivate_sync_ops++; // counted in stat at the next turn
+  return true;
+}
+
+/// note that the caller, with turn held, is about to operate on @obj. An
+/// object seen for the first time becomes private to the caller if
+/// @privatize, and an object private to another thread is made shared,
+/// maybe after waiting for the owner's next turn. The caller's own private
+/// object is made shared too: it only comes here for the operations
+/// privateMutexOp() does not do.
+template <typename _S>
+void RecorderRT<_S>::privateSyncTouch(void *obj, bool privatize) {
+  if (!options::private_sync_fast_path)
+    return;
+  int self = _S::self();
+  while (true) {
+    sync_obj_t *o = syncObj(obj);
+    if (o->private_owner == sync_obj_t::UNSEEN) {
+      // the idle thread's mutex is also locked with the real pthread calls
+      if (!privatize || obj == (void*)&idle_mutex) {
+        o->private_owner = sync_obj_t::SHARED;
+        return;
+      }
+      o->private_owner = self;
+      private_syncs_t &mine = private_syncs.ensure(self);
+      my_private_syncs = &mine;
+      pthread_mutex_t *mu = (pthread_mutex_t*)obj;
+      mine.objs[obj] = useMutexEngine(mu) ? &detMutex(mu) : NULL;
+      return;
+    }
+    int owner = o->private_owner;
+    if (owner == sync_obj_t::SHARED)
+      return;
+    if (owner == self || _S::isWaiting(owner)) {
+      promotePrivateSync(o);
+      return;
+    }
+    private_syncs[owner].requests.push_back(obj);
+    nPrivateSyncRequests++;
+    syncWait(&o->private_owner);
+    // the object may have been destroyed meanwhile; look it up again
+  }
+}
+
+/// for pthread_mutex_init/destroy: make @obj shared, then forget it, so a
+/// new object at the same address starts out unowned
+template <typename _S>
+void RecorderRT<_S>::privateSyncForget(void *obj) {
+  if (!options::private_sync_fast_path)
+    return;
+  privateSyncTouch(obj, false);
+  sync_obj_t *o = _S::syncObjects().find(obj);
+  o->private_owner = sync_obj_t::UNSEEN;
+  _S::syncObjects().release(o);
+}
+
+template <typename _S>
+void RecorderRT<_S>::promotePrivateSync(sync_obj_t *obj) {
+  dprintf("Thread tid %d makes %p of tid %d shared\n", _S::self(), obj->addr, obj->private_owner);
+  private_syncs[obj->private_owner].objs.erase(obj->addr);
+  obj->private_owner = sync_obj_t::SHARED;
+  syncSignal(&obj->private_owner, true);
+}
+
+/// at the caller's turn, share the objects other threads asked for
+template <typename _S>
+void RecorderRT<_S>::promoteRequestedSyncs() {
+  if (!private_syncs.has(_S::self()))
+    return;
+  std::vector<void*> &requests = private_syncs[_S::self()].requests;
+  if (requests.empty())
+    return;
+  nPrivateSyncRequests -= requests.size();
+  for (size_t i = 0; i < requests.size(); i++) {
+    sync_obj_t *o = _S::syncObjects().find(requests[i]);
+    // requested twice, or shared already by a thread it woke
+    if (o && o->private_owner == _S::self())
+      promotePrivateSync(o);
+  }
+  requests.clear();
+}
+
+/// at the thread end, share all objects of the caller
+template <typename _S>
+void RecorderRT<_S>::promoteAllPrivateSyncs() {
+  if (!private_syncs.has(_S::self()))
+    return;
+  promoteRequestedSyncs();
+  std::tr1::unordered_map<void*, det_mutex_t*> &objs = private_syncs[_S::self()].objs;
+  while (!objs.empty())
+    promotePrivateSync(_S::syncObjects().find(objs.begin()->first));
+  my_private_syncs = NULL;
+}
+
+/// before a blocking call, share all objects of the caller, at a turn of
+/// its own: while it blocks it takes no turn, so a thread asking for one of
+/// them (privateSyncTouch()) would wait until the call returns, maybe forever
+template <typename _S>
+void RecorderRT<_S>::sharePrivateSyncs() {
+  if (my_private_syncs->objs.empty())
+    return;
+  unsigned ins = INVALID_INSID;
+  SCHED_TIMER_START;
+  promoteAllPrivateSyncs();
+  SCHED_TIMER_END(syncfunc::tern_preempt, (uint64_t)-1);
+}
+
+/// in a forked child, the owners of private objects other than the caller
+/// are gone, so share everything
+template <typename _S>
+void RecorderRT<_S>::resetPrivateSyncs() {
+  sync_table &objs = _S::syncObjects();
+  for (size_t i = 0; i < objs.slot_count(); i++)
+    if (objs.slot(i) && objs.slot(i)->private_owner >= 0)
+      objs.slot(i)->private_owner = sync_obj_t::SHARED;
+  for (int tid = 0; tid < private_syncs.size(); tid++)
+    if (private_syncs.has(tid)) {
+      private_syncs[tid].objs.clear();
+      private_syncs[tid].requests.clear();
+    }
+  nPrivateSyncRequests = 0;
+  my_private_syncs = NULL;
+}
+
+template <typename _S>
+bool RecorderRT<_S>::myPrivateSync(void *obj, det_mutex_t *&m) {
+  private_syncs_t *mine = my_private_syncs;
+  if (!mine)
+    return false;
+  std::tr1::unordered_map<void*, det_mutex_t*>::iterator it = mine->objs.find(obj);
+  if (it == mine->objs.end())
+    return false;
+  m = it->second;
+  return true;
+}
+
+/// Turn-free init/destroy. Initializing an object, or destroying one, is
+/// only defined while no other thread uses it, so the real call does not
+/// need the turn. What does is the runtime's own state of the object (its
+/// record in the sync table and its private owner), which may be left from
+/// an object that lived at the same address before. deferSync() leaves a
+/// marker instead, and the runtime catches up with it at the thread's next
+/// turn, before anything else the thread does with turn held; the thread
+/// cannot pass the object to another thread without a turn in between, so
+/// the schedule and the logged order of operations stay deterministic.
+template <typename _S>
+bool RecorderRT<_S>::turnFreeSync() {
+  // with no room left, the operation takes the turn, which catches up
+  return options::turn_free_init && my_ndeferred_syncs < MAX_DEFERRED_SYNCS;
+}
+
+template <typename _S>
+void RecorderRT<_S>::deferSync(unsigned ins, unsigned short op, void *obj, int ret, uint64_t arg) {
+  deferred_sync_t &d = my_deferred_syncs[my_ndeferred_syncs++];
+  d.ins = ins;
+  d.op = op;
+  d.obj = obj;
+  d.ret = ret;
+  d.arg = arg;
+  d.app_time = update_time();
+}
+
+template <typename _S>
+void RecorderRT<_S>::catchUpSyncs() {
+  timespec now = update_time();
+  for (unsigned i = 0; i < my_ndeferred_syncs; i++) {
+    deferred_sync_t &d = my_deferred_syncs[i];
+    sync_obj_t *obj = NULL;
+    switch (d.op) {
+    case syncfunc::pthread_mutex_init:
+      if (d.arg) // still private, with its engine state reset
+        break;
+      // fall through
+    case syncfunc::pthread_mutex_destroy:
+      privateSyncForget(d.obj);
+      if (!d.ret && useMutexEngine((pthread_mutex_t*)d.obj))
+        obj = findSyncObj(d.obj, sync_obj_t::MUTEX);
+      break;
+    case syncfunc::pthread_rwlock_init:
+      if (!d.ret && useRWLockEngine())
+        obj = findSyncObj(d.obj, sync_obj_t::RWLOCK);
+      break;
+    case syncfunc::sem_init:
+      if (options::sem_engine) {
+        obj = syncObj(d.obj);
+        obj->kind = sync_obj_t::SEM;
+        obj->sem.value = (unsigned)d.arg;
+        obj = NULL;
+      }
+      break;
+    }
+    if (obj)
+      dropSyncObj(obj);
+    if (options::log_sync) {
+      // logged against this turn, where the schedule would have had it
+      unsigned ins = d.ins;
+      if (d.op == syncfunc::pthread_mutex_init || d.op == syncfunc::pthread_mutex_destroy)
+        Logger::the->logSync(ins, d.op, _S::getTurnCount(), d.app_time, now, now, true, (uint64_t)d.ret);
+      else if (d.op == syncfunc::pthread_rwlock_init)
+        Logger::the->logSync(ins, d.op, _S::getTurnCount(), d.app_time, now, now, true, (uint64_t)d.obj, d.arg, (uint64_t)d.ret);
+      else
+        Logger::the->logSync(ins, d.op, _S::getTurnCount(), d.app_time, now, now, true, (uint64_t)d.obj, (uint64_t)d.ret);
+    }
+  }
+  // counted here, with turn held, rather than in deferSync()
+  if (options::record_runtime_stat)
+    stat.nTurnFreeSyncOp += my_ndeferred_syncs;
+  my_ndeferred_syncs = 0;
+}
+
+template <typename _S>
+void RecorderRT<_S>::condUnlockHelper(pthread_mutex_t *mu) {
+  if (useMutexEngine(mu)) {
+    detMutexUnlock(mu);
+    return;
+  }
+  pthread_mutex_unlock(mu);
+  syncSignal(mu);
+}
+
+/// the record of @cv to wait on. condSignalHelper() needs the mutex of the
+/// waiters only to morph, so only then is the record tagged COND and kept
+/// while it has no waiters
+template <typename _S>
+sync_obj_t *RecorderRT<_S>::condWaitHelper(pthread_cond_t *cv, pthread_mutex_t *mu) {
+  sync_obj_t *obj = syncObj(cv);
+  if (options::cond_wait_morphing && useMutexEngine(mu)) {
+    obj->kind = sync_obj_t::COND;
+    obj->cond_mutex = mu;
+  }
+  return obj;
+}
+
+/// pthread_cond_destroy() is not hooked, so the last waiter to leave @cv
+/// lets its record go
+template <typename _S>
+void RecorderRT<_S>::condWaitEndHelper(pthread_cond_t *cv) {
+  sync_obj_t *obj = findSyncObj(cv, sync_obj_t::COND);
+  if (obj && obj->waiters.num_waiters == 0)
+    dropSyncObj(obj);
+}
+
+template <typename _S>
+void RecorderRT<_S>::condRelockHelper(pthread_mutex_t *mu) {
+  // with wait morphing, the unlock that woke this thread may have handed
+  // it the mutex already
+  if (useMutexEngine(mu) && detMutex(mu).owner == _S::self())
+    return;
+  pthreadMutexLockHelper(mu);
+}
+
 template <typename _S>
 int RecorderRT<_S>::pthreadRWLockWrLockHelper(pthread_rwlock_t *rwlock, unsigned timeout) {
   int ret;
+  if (useRWLockEngine())
+    return detRWLockWrLock(rwlock, true, timeout);
   while((ret=pthread_rwlock_trywrlock(rwlock))) {
     assert(ret==EBUSY && "failed sync calls are not yet supported!");
     ret = syncWait(rwlock, timeout);
@@ -618,6 +1248,8 @@ int RecorderRT<_S>::pthreadRWLockWrLockHelper(pthread_rwlock_t *rwlock, unsigned
 template <typename _S>
 int RecorderRT<_S>::pthreadRWLockRdLockHelper(pthread_rwlock_t *rwlock, unsigned timeout) {
   int ret;
+  if (useRWLockEngine())
+    return detRWLockRdLock(rwlock, true, timeout);
   while((ret=pthread_rwlock_tryrdlock(rwlock))) {
     assert(ret==EBUSY && "failed sync calls are not yet supported!");
     ret = syncWait(rwlock, timeout);
@@ -627,6 +1259,91 @@ int RecorderRT<_S>::pthreadRWLockRdLockHelper(pthread_rwlock_t *rwlock, unsigned
   return 0;
 }
 
+/// The rwlock engine. Without it, every waiter retries trylock on its own
+/// turn and an unlock wakes a single waiter, so readers that could share
+/// the lock get in one at a time. Here an unlock that frees the lock picks
+/// who gets it and counts them in before waking them up: the first waiting
+/// writer, or every waiting reader in one batch, as options::rwlock_prefer_writer
+/// says.
+template <typename _S>
+bool RecorderRT<_S>::useRWLockEngine() {
+  return options::rwlock_engine;
+}
+
+template <typename _S>
+det_rwlock_t &RecorderRT<_S>::detRWLock(pthread_rwlock_t *rwlock) {
+  sync_obj_t *obj = syncObj(rwlock);
+  det_rwlock_t &rw = obj->rwlock;
+  if (obj->kind == sync_obj_t::RWLOCK)
+    return rw;
+  obj->kind = sync_obj_t::RWLOCK;
+  rw.writer = Scheduler::InvalidTid;
+  rw.nreaders = 0;
+  return rw;
+}
+
+template <typename _S>
+int RecorderRT<_S>::detRWLockRdLock(pthread_rwlock_t *rwlock, bool wait, unsigned timeout) {
+  det_rwlock_t &rw = detRWLock(rwlock);
+  if (rw.writer == _S::self())
+    return wait ? EDEADLK : EBUSY;
+  // with writer preference, new readers queue up behind waiting writers
+  if (rw.writer == Scheduler::InvalidTid &&
+      !(options::rwlock_prefer_writer && _S::numWaiters(&rw.writer))) {
+    rw.nreaders++;
+    return 0;
+  }
+  if (!wait)
+    return EBUSY;
+  int ret = syncWait(&rw.nreaders, timeout);
+  if (ret == ETIMEDOUT)
+    return ETIMEDOUT;
+  // the unlock that woke this thread has counted it in @nreaders
+  return 0;
+}
+
+template <typename _S>
+int RecorderRT<_S>::detRWLockWrLock(pthread_rwlock_t *rwlock, bool wait, unsigned timeout) {
+  det_rwlock_t &rw = detRWLock(rwlock);
+  if (rw.writer == _S::self())
+    return wait ? EDEADLK : EBUSY;
+  if (rw.writer == Scheduler::InvalidTid && rw.nreaders == 0) {
+    rw.writer = _S::self();
+    return 0;
+  }
+  if (!wait)
+    return EBUSY;
+  int ret = syncWait(&rw.writer, timeout);
+  if (ret == ETIMEDOUT)
+    return ETIMEDOUT;
+  assert(rw.writer == _S::self() && "unlock must hand the rwlock to the writer it wakes");
+  return 0;
+}
+
+template <typename _S>
+int RecorderRT<_S>::detRWLockUnlock(pthread_rwlock_t *rwlock) {
+  det_rwlock_t &rw = detRWLock(rwlock);
+  if (rw.writer == _S::self())
+    rw.writer = Scheduler::InvalidTid;
+  else if (rw.writer == Scheduler::InvalidTid && rw.nreaders > 0)
+    rw.nreaders--;
+  else
+    return EPERM;
+  if (rw.writer != Scheduler::InvalidTid || rw.nreaders > 0)
+    return 0;
+
+  // waiters that timed out have already left the wait queues
+  size_t nwriters = _S::numWaiters(&rw.writer);
+  size_t nreaders = _S::numWaiters(&rw.nreaders);
+  if (nwriters && (options::rwlock_prefer_writer || !nreaders))
+    rw.writer = syncSignalFirst(&rw.writer);
+  else if (nreaders) {
+    rw.nreaders = nreaders;
+    syncSignal(&rw.nreaders, true);
+  }
+  return 0;
+}
+
 template <typename _S>
 int RecorderRT<_S>::pthreadMutexLock(unsigned ins, int &error, pthread_mutex_t *mu) {
   if (options::enforce_non_det_annotations && inNonDet) {
@@ -636,12 +1353,16 @@ int RecorderRT<_S>::pthreadMutexLock(unsigned ins, int &error, pthread_mutex_t *
     dprintf("Ins %p :   Thread tid %d, self %u is calling non-det pthread_mutex_lock.\n", (void *)ins, _S::self(), (unsigned)pthread_self());
     return Runtime::__pthread_mutex_lock(ins, error, mu);
   }
-  SCHED_TIMER_START;
+  int ret;
+  if (options::private_sync_fast_path && privateMutexOp(ins, error, mu, PRIVATE_LOCK, ret))
+    return ret;
+  SCHED_TIMER_START_ON(mu, NULL);
+  privateSyncTouch(mu, true);
   errno = error;
-  pthreadMutexLockHelper(mu);
+  ret = pthreadMutexLockHelper(mu);
   error = errno;
   SCHED_TIMER_END(syncfunc::pthread_mutex_lock, (uint64_t)mu);
-  return 0;
+  return ret;
 }
 
 template <typename _S>
@@ -653,12 +1374,12 @@ int RecorderRT<_S>::__pthread_rwlock_rdlock(unsigned ins, int &error, pthread_rw
     add_non_det_var((void *)rwlock);
     return pthread_rwlock_rdlock(rwlock);
   }
-  SCHED_TIMER_START;
+  SCHED_TIMER_START_ON(rwlock, NULL);
   errno = error;
-  pthreadRWLockRdLockHelper(rwlock);
+  int ret = pthreadRWLockRdLockHelper(rwlock);
   error = errno;
   SCHED_TIMER_END(syncfunc::pthread_rwlock_rdlock, (uint64_t)rwlock);
-  return 0;
+  return ret;
 }
 
 template <typename _S>
@@ -670,12 +1391,12 @@ int RecorderRT<_S>::__pthread_rwlock_wrlock(unsigned ins, int &error, pthread_rw
     add_non_det_var((void *)rwlock);
     return pthread_rwlock_wrlock(rwlock);
   }
-  SCHED_TIMER_START;
+  SCHED_TIMER_START_ON(rwlock, NULL);
   errno = error;
-  pthreadRWLockWrLockHelper(rwlock);
+  int ret = pthreadRWLockWrLockHelper(rwlock);
   error = errno;
   SCHED_TIMER_END(syncfunc::pthread_rwlock_wrlock, (uint64_t)rwlock);
-  return 0;
+  return ret;
 }
 
 template <typename _S>
@@ -687,9 +1408,13 @@ int RecorderRT<_S>::__pthread_rwlock_tryrdlock(unsigned ins, int &error, pthread
     add_non_det_var((void *)rwlock);
     return pthread_rwlock_tryrdlock(rwlock);
   }
-  SCHED_TIMER_START;
+  SCHED_TIMER_START_ON(rwlock, NULL);
   errno = error;
-  int ret = pthread_rwlock_trywrlock(rwlock); //  FIXME now using wrlock for all rdlock
+  int ret;
+  if (useRWLockEngine())
+    ret = detRWLockRdLock(rwlock, false);
+  else
+    ret = pthread_rwlock_trywrlock(rwlock); //  FIXME now using wrlock for all rdlock
   error = errno;
   SCHED_TIMER_END(syncfunc::pthread_rwlock_tryrdlock, (uint64_t)rwlock, (uint64_t) ret);
   return ret;
@@ -704,9 +1429,13 @@ int RecorderRT<_S>::__pthread_rwlock_trywrlock(unsigned ins, int &error, pthread
     add_non_det_var((void *)rwlock);
     return pthread_rwlock_trywrlock(rwlock);
   }
-  SCHED_TIMER_START;
+  SCHED_TIMER_START_ON(rwlock, NULL);
   errno = error;
-  int ret = pthread_rwlock_trywrlock(rwlock); 
+  int ret;
+  if (useRWLockEngine())
+    ret = detRWLockWrLock(rwlock, false);
+  else
+    ret = pthread_rwlock_trywrlock(rwlock); 
   error = errno;
   SCHED_TIMER_END(syncfunc::pthread_rwlock_trywrlock, (uint64_t)rwlock, (uint64_t) ret);
   return ret;
@@ -722,12 +1451,16 @@ int RecorderRT<_S>::__pthread_rwlock_unlock(unsigned ins, int &error, pthread_rw
     add_non_det_var((void *)rwlock);
     return pthread_rwlock_unlock(rwlock);
   }
-  SCHED_TIMER_START;
+  SCHED_TIMER_START_ON(rwlock, NULL);
 
   errno = error;
-  ret = pthread_rwlock_unlock(rwlock);
+  if (useRWLockEngine())
+    ret = detRWLockUnlock(rwlock);
+  else {
+    ret = pthread_rwlock_unlock(rwlock);
+    syncSignal(rwlock);
+  }
   error = errno;
-  syncSignal(rwlock);
  
   SCHED_TIMER_END(syncfunc::pthread_rwlock_unlock, (uint64_t)rwlock, (uint64_t) ret);
 
@@ -742,9 +1475,28 @@ int RecorderRT<_S>::__pthread_rwlock_destroy(unsigned ins, int &error, pthread_r
     add_non_det_var((void *)rwlock);
     return pthread_rwlock_destroy(rwlock);
   }
+  int ret;
+  if (turnFreeSync() && !useRWLockEngine()) {
+    errno = error;
+    ret = pthread_rwlock_destroy(rwlock);
+    error = errno;
+    deferSync(ins, syncfunc::pthread_rwlock_destroy, rwlock, ret);
+    return ret;
+  }
   SCHED_TIMER_START;
+  _S::forgetSyncObj(rwlock);
   errno = error;
-  int ret = pthread_rwlock_destroy(rwlock); 
+  if (useRWLockEngine()) {
+    sync_obj_t *obj = findSyncObj(rwlock, sync_obj_t::RWLOCK);
+    if (obj && (obj->rwlock.writer != Scheduler::InvalidTid || obj->rwlock.nreaders > 0))
+      ret = EBUSY;
+    else {
+      if (obj)
+        dropSyncObj(obj);
+      ret = pthread_rwlock_destroy(rwlock);
+    }
+  } else
+    ret = pthread_rwlock_destroy(rwlock); 
   error = errno;
   SCHED_TIMER_END(syncfunc::pthread_rwlock_destroy, (uint64_t)rwlock, (uint64_t) ret);
   return ret;
@@ -758,14 +1510,74 @@ int RecorderRT<_S>::__pthread_rwlock_init(unsigned ins, int &error, pthread_rwlo
     add_non_det_var((void *)rwlock);
     return pthread_rwlock_init(rwlock, attr);
   }
+  int ret;
+  if (turnFreeSync()) {
+    errno = error;
+    ret = pthread_rwlock_init(rwlock, attr);
+    error = errno;
+    deferSync(ins, syncfunc::pthread_rwlock_init, rwlock, ret, (uint64_t)attr);
+    return ret;
+  }
   SCHED_TIMER_START;
   errno = error;
-  int ret = pthread_rwlock_init(rwlock, attr); 
+  ret = pthread_rwlock_init(rwlock, attr); 
   error = errno;
+  if (useRWLockEngine() && !ret)
+    if (sync_obj_t *obj = findSyncObj(rwlock, sync_obj_t::RWLOCK))
+      dropSyncObj(obj);
   SCHED_TIMER_END(syncfunc::pthread_rwlock_init, (uint64_t)rwlock, attr, (uint64_t) ret);
   return ret;
 }
 
+template <typename _S>
+int RecorderRT<_S>::__pthread_rwlock_timedrdlock(unsigned ins, int &error, pthread_rwlock_t *rwlock,
+                                                 const struct timespec *abstime) {
+  return pthreadRWLockTimedLockHelper(ins, error, rwlock, abstime, false);
+}
+
+template <typename _S>
+int RecorderRT<_S>::__pthread_rwlock_timedwrlock(unsigned ins, int &error, pthread_rwlock_t *rwlock,
+                                                 const struct timespec *abstime) {
+  return pthreadRWLockTimedLockHelper(ins, error, rwlock, abstime, true);
+}
+
+/// pthread_rwlock_timedwrlock() if @write, else pthread_rwlock_timedrdlock()
+template <typename _S>
+int RecorderRT<_S>::pthreadRWLockTimedLockHelper(unsigned ins, int &error, pthread_rwlock_t *rwlock,
+                                                 const struct timespec *abstime, bool write) {
+  if (options::enforce_non_det_annotations && inNonDet) {
+    if (options::record_runtime_stat)
+      stat.nNonDetPthreadSync++;
+    add_non_det_var((void *)rwlock);
+    return write ? pthread_rwlock_timedwrlock(rwlock, abstime)
+                 : pthread_rwlock_timedrdlock(rwlock, abstime);
+  }
+  if(abstime == NULL)
+    return write ? __pthread_rwlock_wrlock(ins, error, rwlock)
+                 : __pthread_rwlock_rdlock(ins, error, rwlock);
+
+  timespec cur_time, rel_time;
+  if (my_base_time.tv_sec == 0) {
+    fprintf(stderr, "WARN: pthread_rwlock_timed%slock has a non-det timeout. \
+    Please use it with tern_set_base_timespec().\n", write ? "wr" : "rd");
+    clock_gettime(CLOCK_REALTIME, &cur_time);
+  } else {
+    cur_time.tv_sec = my_base_time.tv_sec;
+    cur_time.tv_nsec = my_base_time.tv_nsec;
+  }
+  rel_time = time_diff(cur_time, *abstime);
+
+  SCHED_TIMER_START_ON(rwlock, NULL);
+  unsigned timeout = _S::getTurnCount() + relTimeToTurn(&rel_time);
+  errno = error;
+  int ret = write ? pthreadRWLockWrLockHelper(rwlock, timeout)
+                  : pthreadRWLockRdLockHelper(rwlock, timeout);
+  error = errno;
+  SCHED_TIMER_END(write ? syncfunc::pthread_rwlock_timedwrlock : syncfunc::pthread_rwlock_timedrdlock,
+                  (uint64_t)rwlock, (uint64_t) ret);
+  return ret;
+}
+
 /// instead of looping to get lock as how we implement the regular lock(),
 /// here just trylock once and return.  this preserves the semantics of
 /// trylock().
@@ -778,9 +1590,15 @@ int RecorderRT<_S>::pthreadMutexTryLock(unsigned ins, int &error, pthread_mutex_
     add_non_det_var((void *)mu);
     return pthread_mutex_trylock(mu);
   }
-  SCHED_TIMER_START;
+  if (options::private_sync_fast_path && privateMutexOp(ins, error, mu, PRIVATE_TRYLOCK, ret))
+    return ret;
+  SCHED_TIMER_START_ON(mu, NULL);
+  privateSyncTouch(mu, true);
   errno = error;
-  ret = pthread_mutex_trylock(mu);
+  if (useMutexEngine(mu))
+    ret = detMutexTryLock(mu);
+  else
+    ret = pthread_mutex_trylock(mu);
   error = errno;
   assert((!ret || ret==EBUSY)
          && "failed sync calls are not yet supported!");
@@ -811,7 +1629,8 @@ int RecorderRT<_S>::pthreadMutexTimedLock(unsigned ins, int &error, pthread_mute
   }
   rel_time = time_diff(cur_time, *abstime);
 
-  SCHED_TIMER_START;
+  SCHED_TIMER_START_ON(mu, NULL);
+  privateSyncTouch(mu, false);
   unsigned timeout = _S::getTurnCount() + relTimeToTurn(&rel_time);
   errno = error;
   int ret = pthreadMutexLockHelper(mu, timeout);
@@ -831,15 +1650,22 @@ int RecorderRT<_S>::pthreadMutexUnlock(unsigned ins, int &error, pthread_mutex_t
     dprintf("Thread tid %d, self %u is calling non-det pthread_mutex_unlock.\n", _S::self(), (unsigned)pthread_self());
     return Runtime::__pthread_mutex_unlock(ins, error, mu);
   }
+  if (options::private_sync_fast_path && privateMutexOp(ins, error, mu, PRIVATE_UNLOCK, ret))
+    return ret;
   //fprintf(stderr, "pthreadMutexUnlock1\n");
-  SCHED_TIMER_START;
+  SCHED_TIMER_START_ON(mu, NULL);
+  privateSyncTouch(mu, true);
   //fprintf(stderr, "pthreadMutexUnlock2\n");
   errno = error;
-  ret = pthread_mutex_unlock(mu);
+  if (useMutexEngine(mu))
+    ret = detMutexUnlock(mu);
+  else {
+    ret = pthread_mutex_unlock(mu);
+    //fprintf(stderr, "pthreadMutexUnlock3\n");
+    assert(!ret && "failed sync calls are not yet supported!");
+    syncSignal(mu);
+  }
   error = errno;
-  //fprintf(stderr, "pthreadMutexUnlock3\n");
-  assert(!ret && "failed sync calls are not yet supported!");
-  syncSignal(mu);
   //fprintf(stderr, "pthreadMutexUnlock4\n");
   SCHED_TIMER_END(syncfunc::pthread_mutex_unlock, (uint64_t)mu, (uint64_t) ret);
 
@@ -853,18 +1679,26 @@ int RecorderRT<_S>::pthreadBarrierInit(unsigned ins, int &error, pthread_barrier
   if (options::enforce_non_det_annotations && inNonDet) {
     if (options::record_runtime_stat)
       stat.nNonDetPthreadSync++;
+    // the engine's barriers only work with the turn held
+    assert(!options::barrier_engine && "barrier_engine barriers used inside a non_det region!");
     add_non_det_var((void *)barrier);
     return pthread_barrier_init(barrier, NULL, count);
   }
   SCHED_TIMER_START;
+  if (options::barrier_engine) {
+    ret = detBarrierInit(barrier, count);
+    SCHED_TIMER_END(syncfunc::pthread_barrier_init, (uint64_t)barrier, (uint64_t) count);
+    return ret;
+  }
   errno = error;
   ret = pthread_barrier_init(barrier, NULL, count);
   error = errno;
   assert(!ret && "failed sync calls are not yet supported!");
-  assert(barriers.find(barrier) == barriers.end()
-         && "barrier already initialized!");
-  barriers[barrier].count = count;
-  barriers[barrier].narrived = 0;
+  sync_obj_t *obj = syncObj(barrier);
+  assert(obj->kind != sync_obj_t::BARRIER && "barrier already initialized!");
+  obj->kind = sync_obj_t::BARRIER;
+  obj->barrier.count = count;
+  obj->barrier.narrived = 0;
 
   SCHED_TIMER_END(syncfunc::pthread_barrier_init, (uint64_t)barrier, (uint64_t) count);
  
@@ -908,15 +1742,24 @@ int RecorderRT<_S>::pthreadBarrierWait(unsigned ins, int &error,
   if (options::enforce_non_det_annotations && inNonDet) {
     if (options::record_runtime_stat)
       stat.nNonDetPthreadSync++;
+    // the engine's barriers only work with the turn held
+    assert(!options::barrier_engine && "barrier_engine barriers used inside a non_det region!");
     add_non_det_var((void *)barrier);
     return pthread_barrier_wait(barrier);
   }
-  SCHED_TIMER_START;
+  SCHED_TIMER_START_ON(barrier, NULL);
   SCHED_TIMER_FAKE_END(syncfunc::pthread_barrier_wait, (uint64_t)barrier);
+
+  if (options::barrier_engine) {
+    ret = detBarrierWait(barrier);
+    sched_time = update_time();
+    SCHED_TIMER_END(syncfunc::pthread_barrier_wait, (uint64_t)barrier);
+    return ret;
+  }
   
-  barrier_map::iterator bi = barriers.find(barrier);
-  assert(bi!=barriers.end() && "barrier is not initialized!");
-  barrier_t &b = bi->second;
+  sync_obj_t *obj = findSyncObj(barrier, sync_obj_t::BARRIER);
+  assert(obj && "barrier is not initialized!");
+  barrier_t &b = obj->barrier;
 
   ++ b.narrived;
 
@@ -930,7 +1773,7 @@ int RecorderRT<_S>::pthreadBarrierWait(unsigned ins, int &error,
   assert(b.narrived <= b.count && "barrier overflow!");
   if(b.count == b.narrived) {
     b.narrived = 0; // barrier may be reused
-    syncSignal(barrier, /*all=*/true);
+    syncSignalList(obj->waiters);
     // according to the man page of pthread_barrier_wait, one of the
     // waiters should return PTHREAD_BARRIER_SERIAL_THREAD, instead of 0
     ret = PTHREAD_BARRIER_SERIAL_THREAD;
@@ -941,10 +1784,10 @@ int RecorderRT<_S>::pthreadBarrierWait(unsigned ins, int &error,
 #endif
 
     _S::putTurn();  // this gives _first and _second different turn numbers.
-    _S::getTurn();
+    _S::getTurnOn(barrier);
   } else {
     ret = 0;
-    syncWait(barrier);
+    syncWaitList(obj->waiters);
   }
   sched_time = update_time();
 #ifdef xxx
@@ -965,10 +1808,18 @@ int RecorderRT<_S>::pthreadBarrierDestroy(unsigned ins, int &error,
   if (options::enforce_non_det_annotations && inNonDet) {
     if (options::record_runtime_stat)
       stat.nNonDetPthreadSync++;
+    // the engine's barriers only work with the turn held
+    assert(!options::barrier_engine && "barrier_engine barriers used inside a non_det region!");
     add_non_det_var((void *)barrier);
     return pthread_barrier_destroy(barrier);
   }
   SCHED_TIMER_START;
+  _S::forgetSyncObj(barrier);
+  if (options::barrier_engine) {
+    ret = detBarrierDestroy(barrier);
+    SCHED_TIMER_END(syncfunc::pthread_barrier_destroy, (uint64_t)barrier, (uint64_t) ret);
+    return ret;
+  }
   errno = error;
   ret = pthread_barrier_destroy(barrier);
   error = errno;
@@ -976,9 +1827,9 @@ int RecorderRT<_S>::pthreadBarrierDestroy(unsigned ins, int &error,
   // pthread_barrier_destroy returns EBUSY if the barrier is still in use
   assert((!ret || ret==EBUSY) && "failed sync calls are not yet supported!");
   if(!ret) {
-    barrier_map::iterator bi = barriers.find(barrier);
-    assert(bi != barriers.end() && "barrier not initialized!");
-    barriers.erase(bi);
+    sync_obj_t *obj = findSyncObj(barrier, sync_obj_t::BARRIER);
+    assert(obj && "barrier not initialized!");
+    dropSyncObj(obj);
   }
   
   SCHED_TIMER_END(syncfunc::pthread_barrier_destroy, (uint64_t)barrier, (uint64_t) ret);
@@ -986,6 +1837,74 @@ int RecorderRT<_S>::pthreadBarrierDestroy(unsigned ins, int &error,
   return ret;
 }
 
+/// The barrier engine. The default path looks the barrier's record up in
+/// the sync table, and makes the last arriving thread give up its turn and
+/// wait for it once more. Here the pthread_barrier_t itself points to its
+/// record, and the last arriving thread splices the record's waiters onto
+/// the run queue and keeps its turn; it still goes to the back of the run
+/// queue, behind the threads it released, when it leaves
+/// pthread_barrier_wait().
+template <typename _S>
+int RecorderRT<_S>::detBarrierInit(pthread_barrier_t *barrier, unsigned count) {
+  if (count == 0)
+    return EINVAL;
+  sync_obj_t *obj = syncObj(barrier);
+  assert(obj->waiters.num_waiters == 0);
+  obj->kind = sync_obj_t::BARRIER;
+  obj->barrier.count = count;
+  obj->barrier.narrived = 0;
+  det_barrier_ref_t *ref = (det_barrier_ref_t *)barrier;
+  ref->magic = det_barrier_ref_t::MAGIC;
+  ref->obj = obj;
+  return 0;
+}
+
+template <typename _S>
+sync_obj_t *RecorderRT<_S>::detBarrier(pthread_barrier_t *barrier) {
+  det_barrier_ref_t *ref = (det_barrier_ref_t *)barrier;
+  assert(ref->magic == det_barrier_ref_t::MAGIC && ref->obj->addr == barrier
+         && ref->obj->kind == sync_obj_t::BARRIER && "barrier is not initialized!");
+  return ref->obj;
+}
+
+template <typename _S>
+int RecorderRT<_S>::detBarrierWait(pthread_barrier_t *barrier) {
+  sync_obj_t *obj = detBarrier(barrier);
+  barrier_t &b = obj->barrier;
+  ++ b.narrived;
+  assert(b.narrived <= b.count && "barrier overflow!");
+  if (b.narrived < b.count) {
+    syncWaitList(obj->waiters);
+    return 0;
+  }
+  b.narrived = 0; // barrier may be reused
+  syncSignalList(obj->waiters);
+  return PTHREAD_BARRIER_SERIAL_THREAD;
+}
+
+template <typename _S>
+int RecorderRT<_S>::detBarrierDestroy(pthread_barrier_t *barrier) {
+  sync_obj_t *obj = detBarrier(barrier);
+  if (obj->barrier.narrived > 0)
+    return EBUSY;
+  det_barrier_ref_t *ref = (det_barrier_ref_t *)barrier;
+  ref->magic = 0;
+  ref->obj = NULL;
+  dropSyncObj(obj);
+  return 0;
+}
+
+/// in a forked child, the threads waiting at barriers are gone
+template <typename _S>
+void RecorderRT<_S>::resetBarriers() {
+  sync_table &objs = _S::syncObjects();
+  for (size_t i = 0; i < objs.slot_count(); i++) {
+    sync_obj_t *obj = objs.slot(i);
+    if (obj && obj->kind == sync_obj_t::BARRIER)
+      obj->barrier.narrived = 0;
+  }
+}
+
 /// The issues with pthread_cond_wait()
 ///
 /// ------ First issue: deadlock. Normally, we'd want to do
@@ -1218,16 +2137,18 @@ int RecorderRT<_S>::pthreadCondWait(unsigned ins, int &error,
     add_non_det_var((void *)mu);
     return pthread_cond_wait(cv, mu);
   }
-  SCHED_TIMER_START;
-  pthread_mutex_unlock(mu);
-  syncSignal(mu);
+  SCHED_TIMER_START_ON(mu, cv);
+  privateSyncTouch(mu, false);
+  condUnlockHelper(mu);
+  sync_obj_t *obj = condWaitHelper(cv, mu);
 
   SCHED_TIMER_FAKE_END(syncfunc::pthread_cond_wait, (uint64_t)cv, (uint64_t)mu);
-  syncWait(cv);
+  syncWaitList(obj->waiters);
   sched_time = update_time();
   errno = error;
-  pthreadMutexLockHelper(mu);
+  condRelockHelper(mu);
   error = errno;
+  condWaitEndHelper(cv);
   
   SCHED_TIMER_END(syncfunc::pthread_cond_wait, (uint64_t)cv, (uint64_t)mu);
   return 0;
@@ -1261,23 +2182,25 @@ int RecorderRT<_S>::pthreadCondTimedWait(unsigned ins, int &error,
     add_non_det_var((void *)mu);
     return pthread_cond_timedwait(cv, mu, abstime);
   }
-  SCHED_TIMER_START;
-  pthread_mutex_unlock(mu);
+  SCHED_TIMER_START_ON(mu, cv);
+  privateSyncTouch(mu, false);
+  condUnlockHelper(mu);
 
   SCHED_TIMER_FAKE_END(syncfunc::pthread_cond_timedwait, (uint64_t)cv, (uint64_t)mu, (uint64_t) 0);
 
-  syncSignal(mu);
+  sync_obj_t *obj = condWaitHelper(cv, mu);
   unsigned nTurns = relTimeToTurn(&rel_time);
   dprintf("Tid %d pthreadCondTimedWait physical time interval %ld.%ld, logical turns %u\n",
     _S::self(), (long)rel_time.tv_sec, (long)rel_time.tv_nsec, nTurns);
   unsigned timeout = _S::getTurnCount() + nTurns;
-  saved_ret = ret = syncWait(cv, timeout);
+  saved_ret = ret = syncWaitList(obj->waiters, timeout);
   dprintf("timedwait return = %d, after %d turns\n", ret, _S::getTurnCount() - nturn);
 
   sched_time = update_time();
   errno = error;
-  pthreadMutexLockHelper(mu);
+  condRelockHelper(mu);
   error = errno;
+  condWaitEndHelper(cv);
   SCHED_TIMER_END(syncfunc::pthread_cond_timedwait, (uint64_t)cv, (uint64_t)mu, (uint64_t) saved_ret);
 
   return saved_ret;
@@ -1292,9 +2215,9 @@ int RecorderRT<_S>::pthreadCondSignal(unsigned ins, int &error, pthread_cond_t *
     return pthread_cond_signal(cv);
   }
   //fprintf(stderr, "pthreadCondSignal start...\n");
-  SCHED_TIMER_START;
+  SCHED_TIMER_START_ON(cv, NULL);
   //fprintf(stderr, "pthreadCondSignal start got turn...\n");
-  syncSignal(cv);
+  condSignalHelper(cv, false);
   //fprintf(stderr, "pthreadCondSignal start got turn2...\n");
   SCHED_TIMER_END(syncfunc::pthread_cond_signal, (uint64_t)cv);
   //fprintf(stderr, "pthreadCondSignal start put turn...\n");
@@ -1309,8 +2232,8 @@ int RecorderRT<_S>::pthreadCondBroadcast(unsigned ins, int &error, pthread_cond_
     add_non_det_var((void *)cv);
     return pthread_cond_broadcast(cv);
   }
-  SCHED_TIMER_START;
-  syncSignal(cv, /*all=*/true);
+  SCHED_TIMER_START_ON(cv, NULL);
+  condSignalHelper(cv, /*all=*/true);
   SCHED_TIMER_END(syncfunc::pthread_cond_broadcast, (uint64_t)cv);
   return 0;
 }
@@ -1319,13 +2242,20 @@ template <typename _S>
 int RecorderRT<_S>::semWait(unsigned ins, int &error, sem_t *sem) {
   int ret;
   if (options::enforce_non_det_annotations && inNonDet) {
+    // the engine's count lives outside the sem_t, and needs the turn
+    assert(!options::sem_engine && "sem_engine semaphores used inside a non_det region!");
     if (options::record_runtime_stat)
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)sem);
     //fprintf(stderr, "non det sem wait...\n");
     return Runtime::__sem_wait(ins, error, sem);
   }
-  SCHED_TIMER_START;
+  SCHED_TIMER_START_ON(sem, NULL);
+  if (options::sem_engine) {
+    detSemWait(sem, true);
+    SCHED_TIMER_END(syncfunc::sem_wait, (uint64_t)sem);
+    return 0;
+  }
   while((ret=sem_trywait(sem)) != 0) {
     // WTH? pthread_mutex_trylock returns EBUSY if lock is held, yet
     // sem_trywait returns -1 and sets errno to EAGAIN if semaphore is not
@@ -1342,12 +2272,23 @@ template <typename _S>
 int RecorderRT<_S>::semTryWait(unsigned ins, int &error, sem_t *sem) {
   int ret;
   if (options::enforce_non_det_annotations && inNonDet) {
+    assert(!options::sem_engine && "sem_engine semaphores used inside a non_det region!");
     if (options::record_runtime_stat)
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)sem);
     return sem_trywait(sem);
   }
-  SCHED_TIMER_START;
+  SCHED_TIMER_START_ON(sem, NULL);
+  if (options::sem_engine) {
+    if (detSemWait(sem, false) == 0)
+      ret = 0;
+    else {
+      ret = -1;
+      error = EAGAIN;
+    }
+    SCHED_TIMER_END(syncfunc::sem_trywait, (uint64_t)sem, (uint64_t)ret);
+    return ret;
+  }
   errno = error;
   ret = sem_trywait(sem);
   error = errno;
@@ -1378,15 +2319,23 @@ int RecorderRT<_S>::semTimedWait(unsigned ins, int &error, sem_t *sem,
   
   int ret;
   if (options::enforce_non_det_annotations && inNonDet) {
+    assert(!options::sem_engine && "sem_engine semaphores used inside a non_det region!");
     if (options::record_runtime_stat)
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)sem);
     return sem_timedwait(sem, abstime);
   }
-  SCHED_TIMER_START;
+  SCHED_TIMER_START_ON(sem, NULL);
   
   unsigned timeout = _S::getTurnCount() + relTimeToTurn(&rel_time);
-  while((ret=sem_trywait(sem))) {
+  if (options::sem_engine) {
+    ret = 0;
+    if (detSemWait(sem, true, timeout) == ETIMEDOUT) {
+      ret = -1;
+      saved_err = ETIMEDOUT;
+      error = ETIMEDOUT;
+    }
+  } else while((ret=sem_trywait(sem))) {
     assert(errno==EAGAIN && "failed sync calls are not yet supported!");
     ret = syncWait(sem, timeout);
     if(ret == ETIMEDOUT) {
@@ -1406,12 +2355,22 @@ template <typename _S>
 int RecorderRT<_S>::semPost(unsigned ins, int &error, sem_t *sem){
   int ret;
   if (options::enforce_non_det_annotations && inNonDet) {
+    assert(!options::sem_engine && "sem_engine semaphores used inside a non_det region!");
     if (options::record_runtime_stat)
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)sem);
     return Runtime::__sem_post(ins, error, sem);
   }
-  SCHED_TIMER_START;
+  SCHED_TIMER_START_ON(sem, NULL);
+  if (options::sem_engine) {
+    ret = detSemPost(sem);
+    if (ret) {
+      error = ret;
+      ret = -1;
+    }
+    SCHED_TIMER_END(syncfunc::sem_post, (uint64_t)sem, (uint64_t)ret);
+    return ret;
+  }
   ret = sem_post(sem);
   assert(!ret && "failed sync calls are not yet supported!");
   syncSignal(sem);
@@ -1429,14 +2388,107 @@ int RecorderRT<_S>::semInit(unsigned ins, int &error, sem_t *sem, int pshared, u
     add_non_det_var((void *)sem);
     return Runtime::__sem_init(ins, error, sem, pshared, value);
   }
+  if (turnFreeSync()) {
+    ret = sem_init(sem, pshared, value);
+    assert(!ret && "failed sync calls are not yet supported!");
+    deferSync(ins, syncfunc::sem_init, sem, ret, value);
+    return 0;
+  }
   SCHED_TIMER_START;
   ret = sem_init(sem, pshared, value);
   assert(!ret && "failed sync calls are not yet supported!");
+  if (options::sem_engine) {
+    sync_obj_t *obj = syncObj(sem);
+    obj->kind = sync_obj_t::SEM;
+    obj->sem.value = value;
+  }
   SCHED_TIMER_END(syncfunc::sem_init, (uint64_t)sem, (uint64_t)ret);
 
   return 0;
 }
 
+template <typename _S>
+int RecorderRT<_S>::semDestroy(unsigned ins, int &error, sem_t *sem) {
+  int ret;
+  if (options::enforce_non_det_annotations && inNonDet) {
+    assert(!options::sem_engine && "sem_engine semaphores used inside a non_det region!");
+    if (options::record_runtime_stat)
+      stat.nNonDetPthreadSync++;
+    add_non_det_var((void *)sem);
+    return Runtime::__sem_destroy(ins, error, sem);
+  }
+  SCHED_TIMER_START;
+  _S::forgetSyncObj(sem);
+  errno = error;
+  ret = sem_destroy(sem);
+  error = errno;
+  if (sync_obj_t *obj = findSyncObj(sem, sync_obj_t::SEM))
+    dropSyncObj(obj);
+  SCHED_TIMER_END(syncfunc::sem_destroy, (uint64_t)sem, (uint64_t)ret);
+  return ret;
+}
+
+template <typename _S>
+int RecorderRT<_S>::semGetValue(unsigned ins, int &error, sem_t *sem, int *sval) {
+  int ret;
+  if (!options::sem_engine || (options::enforce_non_det_annotations && inNonDet)) {
+    errno = error;
+    ret = sem_getvalue(sem, sval);
+    error = errno;
+    return ret;
+  }
+  SCHED_TIMER_START_ON(sem, NULL);
+  *sval = (int)detSem(sem).value;
+  SCHED_TIMER_END(syncfunc::sem_getvalue, (uint64_t)sem, (uint64_t)*sval);
+  return 0;
+}
+
+/// The semaphore engine. Without it, sem_post() posts the real semaphore
+/// and wakes one waiter, which comes around the run queue and retries
+/// sem_trywait(), and may find the unit already taken by a thread that
+/// got its turn first. Here sem_post() gives the unit to the first waiter
+/// before waking it up, so a woken waiter always returns with its unit,
+/// and no real semaphore operation is made. sem_timedwait() waits with
+/// the same timeout as the default path; a waiter that times out has left
+/// the wait queue, so no unit is handed to it.
+template <typename _S>
+det_sem_t &RecorderRT<_S>::detSem(sem_t *sem) {
+  sync_obj_t *obj = syncObj(sem);
+  det_sem_t &s = obj->sem;
+  if (obj->kind == sync_obj_t::SEM)
+    return s;
+  // initialized before the runtime started or inside a non_det region
+  int value = 0;
+  sem_getvalue(sem, &value);
+  obj->kind = sync_obj_t::SEM;
+  s.value = value > 0 ? value : 0;
+  return s;
+}
+
+template <typename _S>
+int RecorderRT<_S>::detSemWait(sem_t *sem, bool wait, unsigned timeout) {
+  det_sem_t &s = detSem(sem);
+  if (s.value > 0) {
+    s.value--;
+    return 0;
+  }
+  if (!wait)
+    return EAGAIN;
+  // the post that wakes this thread hands it its unit
+  return syncWait(sem, timeout);
+}
+
+template <typename _S>
+int RecorderRT<_S>::detSemPost(sem_t *sem) {
+  det_sem_t &s = detSem(sem);
+  if (syncSignalFirst(sem) != Scheduler::InvalidTid)
+    return 0;
+  if (s.value >= SEM_VALUE_MAX)
+    return EOVERFLOW;
+  s.value++;
+  return 0;
+}
+
 template <typename _S>
 void RecorderRT<_S>::lineupInit(long opaque_type, unsigned count, unsigned timeout_turns) {
   unsigned ins = opaque_type;
@@ -1448,14 +2500,18 @@ void RecorderRT<_S>::lineupInit(long opaque_type, unsigned count, unsigned timeo
   }
   SCHED_TIMER_START;
   //fprintf(stderr, "lineupInit opaque_type %p, count %u, timeout %u\n", (void *)opaque_type, count, timeout_turns);
-  if (refcnt_bars.find(opaque_type) != refcnt_bars.end()) {
+  sync_obj_t *obj = syncObj((void *)opaque_type);
+  if (obj->kind == sync_obj_t::LINEUP) {
     fprintf(stderr, "refcnt barrier %p already initialized!\n", (void *)opaque_type);
     assert(false);
   }
-  refcnt_bars[opaque_type].count = count;
-  refcnt_bars[opaque_type].nactive = 0;
-  refcnt_bars[opaque_type].timeout = timeout_turns;
-  refcnt_bars[opaque_type].setArriving();
+  obj->kind = sync_obj_t::LINEUP;
+  ref_cnt_barrier_t &b = obj->lineup;
+  b.count = count;
+  b.nactive = 0;
+  b.timeout = timeout_turns;
+  b.nSuccess = b.nTimeout = 0;
+  b.setArriving();
   SCHED_TIMER_END(syncfunc::tern_lineup_init, (uint64_t)opaque_type, (uint64_t) count, (uint64_t) timeout_turns);
 }
 
@@ -1470,14 +2526,9 @@ void RecorderRT<_S>::lineupDestroy(long opaque_type) {
   }
   SCHED_TIMER_START;
   //fprintf(stderr, "lineupDestroy opaque_type %p\n", (void *)opaque_type);
-  assert(refcnt_bars.find(opaque_type) != refcnt_bars.end() && "refcnt barrier is not initialized!");
-  refcnt_bars[opaque_type].count = 0;
-  refcnt_bars[opaque_type].nactive = 0;
-  refcnt_bars[opaque_type].timeout = 0;
-  refcnt_bars[opaque_type].nSuccess = 0;
-  refcnt_bars[opaque_type].nTimeout = 0;
-  refcnt_bars[opaque_type].setArriving();  
-  refcnt_bars.erase(opaque_type);
+  sync_obj_t *obj = findSyncObj((void *)opaque_type, sync_obj_t::LINEUP);
+  assert(obj && "refcnt barrier is not initialized!");
+  dropSyncObj(obj);
   SCHED_TIMER_END(syncfunc::tern_lineup_destroy, (uint64_t)opaque_type);
 }
 
@@ -1495,9 +2546,9 @@ void RecorderRT<_S>::lineupStart(long opaque_type) {
   record_rdtsc_op(__FUNCTION__, "START", 1, NULL); // Record rdtsc start, disabled by default.
 
   SCHED_TIMER_START;
-  refcnt_bar_map::iterator bi = refcnt_bars.find(opaque_type);
-  assert(bi != refcnt_bars.end() && "refcnt barrier is not initialized!");
-  ref_cnt_barrier_t &b = bi->second;
+  sync_obj_t *obj = findSyncObj((void *)opaque_type, sync_obj_t::LINEUP);
+  assert(obj && "refcnt barrier is not initialized!");
+  ref_cnt_barrier_t &b = obj->lineup;
   b.nactive++;  
   //fprintf(stderr, "lineupStart opaque_type %p, tid %d, count %d, nactive %u\n", (void *)opaque_type, _S::self(), b.count, b.nactive);
 
@@ -1511,14 +2562,14 @@ void RecorderRT<_S>::lineupStart(long opaque_type) {
       if (options::record_runtime_stat)
         stat.nLineupSucc++;
       b.setLeaving();
-      syncSignal(&b, true); // Signal all threads blocking on this barrier.
+      syncSignalList(obj->waiters); // Signal all threads blocking on this barrier.
     } else {
       // NOP. There could be a case that after timeout happens,
       // all threads arrive, then we just let them do NOP, and deterministic.
     } 
   } else {
     if (b.isArriving()) {
-      syncWait(&b, _S::getTurnCount() + b.timeout);
+      syncWaitList(obj->waiters, _S::getTurnCount() + b.timeout);
      
       // Handle timeout here, since the wait() would call getTurn and still grab the turn.
       if (b.nactive < b.count && b.isArriving()) {
@@ -1528,7 +2579,7 @@ void RecorderRT<_S>::lineupStart(long opaque_type) {
         if (options::record_runtime_stat)
           stat.nLineupTimeout++;
         b.setLeaving();
-        syncSignal(&b, true); // Signal all threads blocking on this barrier.
+        syncSignalList(obj->waiters); // Signal all threads blocking on this barrier.
       }
     } else {
       // proceed. NOP.
@@ -1550,9 +2601,9 @@ void RecorderRT<_S>::lineupEnd(long opaque_type) {
     return;
   }
   SCHED_TIMER_START;
-  refcnt_bar_map::iterator bi = refcnt_bars.find(opaque_type);
-  assert(bi != refcnt_bars.end() && "refcnt barrier is not initialized!");
-  ref_cnt_barrier_t &b = bi->second;
+  sync_obj_t *obj = findSyncObj((void *)opaque_type, sync_obj_t::LINEUP);
+  assert(obj && "refcnt barrier is not initialized!");
+  ref_cnt_barrier_t &b = obj->lineup;
   b.nactive--;
   //fprintf(stderr, "lineupEnd opaque_type %p, tid %d, nactive %u\n", (void *)opaque_type, _S::self(), b.nactive);
   if (b.nactive == 0 && b.isLeaving()) {
@@ -1655,6 +2706,37 @@ void RecorderRT<_S>::setBaseTime(struct timespec *ts) {
   my_base_time.tv_nsec = ts->tv_nsec;
 }
 
+/// a turn of its own, so that the move happens at a deterministic point
+template <typename _S>
+void RecorderRT<_S>::setDomain(int domain) {
+  unsigned ins = INVALID_INSID;
+  SCHED_TIMER_START;
+  _S::setDomain(domain);
+  SCHED_TIMER_END(syncfunc::tern_set_domain, (uint64_t)domain);
+}
+
+/// no turn: only the calling thread's own clock moves, unless it is time
+/// for preempt()
+template <typename _S>
+bool RecorderRT<_S>::backEdge(int id) {
+  _S::advanceClock(1);
+  return options::backedge_preempt &&
+    ++my_nbackedges >= (unsigned)options::backedge_preempt && !inNonDet;
+}
+
+/** A thread spinning on a plain flag or a custom spinlock makes no sync
+call, so it keeps the turn the others wait for once the turn gets to it.
+After backedge_preempt back-edges it takes the turn and passes it on, as
+sched_yield() does. privateMutexOp() does the same, with @id -1, and so
+does sharePrivateSyncs() in its log entry. **/
+template <typename _S>
+void RecorderRT<_S>::preempt(int id) {
+  unsigned ins = INVALID_INSID;
+  dprintf("preempt, tid %d, back-edge %d\n", _S::self(), id);
+  SCHED_TIMER_START;
+  SCHED_TIMER_END(syncfunc::tern_preempt, (uint64_t)id);
+}
+
 template <typename _S>
 void RecorderRT<_S>::symbolic(unsigned ins, int &error, void *addr,
                               int nbyte, const char *name){
@@ -2171,6 +3253,8 @@ pid_t RecorderRT<_S>::__fork(unsigned ins, int &error)
     assert(!sem_init(&thread_begin_sem, 0, 0));
     assert(!sem_init(&thread_begin_done_sem, 0, 0));
     _S::childForkReturn();
+    resetPrivateSyncs();
+    resetBarriers();
   } else
     assert(ret > 0);
   SCHED_TIMER_END(syncfunc::fork, (uint64_t) ret);
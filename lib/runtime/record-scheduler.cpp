@@ -29,6 +29,9 @@
 #include <cstring>
 #include <algorithm>
 #include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 #include "tern/options.h"
 #include "tern/runtime/rdtsc.h"
 
@@ -60,36 +63,93 @@ extern int idle_done;
 extern int nNonDetWait;
 extern pthread_cond_t nonDetCV;
 
+static inline long long now_ns(clockid_t clk) {
+  struct timespec ts;
+  clock_gettime(clk, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
 
 void RRScheduler::wait_t::wait() {
   if (options::enforce_turn_type == 1) {  // Semaphore relay.
     sem_wait(&sem);
   } else if (options::enforce_turn_type == 2) {  // Hybrid relay.
-    /** by default, 3e4. This would cause the busy loop to loop for around 10 ms 
-    on my machine, or 14 ms on bug00. This is one order of magnitude bigger
-    than context switch time (1ms). **/
-    /**
-    2013-2-17: changed it to 4e5. It makes the parsec/flui* benchmark runs 
-    with very small overhead (2~4 busywait timeouts) on bug00. If we choose 4e4, then there
-    would be hundredsof timeouts.
-    **/
-    const long waitCnt = 4e5;
+    /** 2013-2-17: the spin window used to be a fixed 4e5 sched_yield()s, tuned
+    for parsec/flui* on bug00 (2~4 busywait timeouts). With adaptive_spin it starts
+    small, so oversubscribed threads do not burn their CPU share before they have
+    adapted, and then follows how long the handoffs to this thread actually take. **/
+    long budget = options::adaptive_spin ? spinBudget : options::spin_count_max;
+    long long cpuStart = options::record_runtime_stat ? now_ns(CLOCK_THREAD_CPUTIME_ID) : 0;
+    long long spinStart = options::adaptive_spin ? now_ns(CLOCK_MONOTONIC) : 0;
     volatile long i = 0;
-    while (!wakenUp && i < waitCnt) {
+    while (!wakenUp && i < budget) {
       sched_yield();
       i++;
     }
+    if (options::record_runtime_stat)
+      nSpinNs += now_ns(CLOCK_THREAD_CPUTIME_ID) - cpuStart;
     if (!wakenUp) {
+      long long parkStart = options::adaptive_spin ? now_ns(CLOCK_MONOTONIC) : 0;
       pthread_mutex_lock(&mutex);
       while (!wakenUp) {/** This can save the context switch overhead. **/
         dprintf("RRScheduler::wait_t::wait before cond wait, tid %d\n", self());
+        parked = true;
         pthread_cond_wait(&cond, &mutex);
+        parked = false;
         dprintf("RRScheduler::wait_t::wait after cond wait, tid %d\n", self());
+        if (prewoken && !wakenUp) {
+          /** prewake(): the turn is a few handoffs away, wait for it spinning
+          (outside @mutex, which post() takes), then sleep again. **/
+          prewoken = false;
+          pthread_mutex_unlock(&mutex);
+          for (int i = 0; !wakenUp && i < options::prewake_spin_count; i++)
+            sched_yield();
+          pthread_mutex_lock(&mutex);
+        }
       }
       wakenUp = false;
+      prewoken = false;
       pthread_mutex_unlock(&mutex);
+      nParks++;
+      if (options::adaptive_spin) {
+        /** The turn came after we gave up. If spinning twice as long would have
+        caught it, widen the window; otherwise spinning was wasted, narrow it. **/
+        long long spinTime = parkStart - spinStart;
+        long long handoffTime = now_ns(CLOCK_MONOTONIC) - spinStart;
+        if (handoffTime < 2 * spinTime)
+          spinBudget = std::min(2 * spinBudget, (long)options::spin_count_max);
+        else
+          spinBudget = std::max(spinBudget / 2, (long)options::spin_count_min);
+      }
     } else {
       wakenUp = false;
+      nSpins++;
+      if (options::adaptive_spin) {
+        /** The turn came after @i spins: keep twice that as headroom, and decay
+        slowly so one slow handoff does not keep the window wide. **/
+        spinBudget = std::max(spinBudget - spinBudget / 16, 2 * i);
+        spinBudget = std::max(std::min(spinBudget, (long)options::spin_count_max),
+                              (long)options::spin_count_min);
+      }
+    }
+  } else if (options::enforce_turn_type == 4) {  // Futex relay.
+    /** Spin a little in case the turn comes back soon, then sleep in the kernel.
+    The poster only calls FUTEX_WAKE if we have marked the word FUTEX_PARKED. **/
+    for (int i = 0; futex != FUTEX_POSTED && i < options::futex_spin_count; i++)
+      sched_yield();
+    if (futex == FUTEX_POSTED)
+      nSpins++;
+    else
+      nParks++;
+    while (!__sync_bool_compare_and_swap(&futex, FUTEX_POSTED, FUTEX_IDLE)) {
+      if (__sync_bool_compare_and_swap(&futex, FUTEX_IDLE, FUTEX_PARKED) || futex == FUTEX_PARKED) {
+        dprintf("RRScheduler::wait_t::wait before futex wait, tid %d\n", self());
+        syscall(SYS_futex, &futex, FUTEX_WAIT_PRIVATE, FUTEX_PARKED, NULL, NULL, 0);
+        dprintf("RRScheduler::wait_t::wait after futex wait, tid %d\n", self());
+        /** Still FUTEX_IDLE: prewake() woke us up, the turn is a few handoffs
+        away. Wait for it spinning, then sleep again. **/
+        for (int i = 0; futex == FUTEX_IDLE && i < options::prewake_spin_count; i++)
+          sched_yield();
+      }
     }
   } else {  // Busy relay.
     while (!wakenUp) {
@@ -107,6 +167,9 @@ void RRScheduler::wait_t::post() {
     wakenUp = true;
     pthread_cond_signal(&cond);
     pthread_mutex_unlock(&mutex);
+  } else if (options::enforce_turn_type == 4) {  // Futex relay.
+    if (__sync_lock_test_and_set(&futex, FUTEX_POSTED) == FUTEX_PARKED)
+      syscall(SYS_futex, &futex, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
   } else {  // Busy relay.
     //pthread_mutex_lock(&mutex);
     wakenUp = true;
@@ -114,40 +177,58 @@ void RRScheduler::wait_t::post() {
   }
 }
 
+void RRScheduler::wait_t::prewake() {
+  if (options::enforce_turn_type == 2) {  // Hybrid relay.
+    if (!parked) // a hint only: the owner spins, or is not waiting at all
+      return;
+    pthread_mutex_lock(&mutex);
+    if (parked && !wakenUp) {
+      prewoken = true;
+      pthread_cond_signal(&cond);
+    }
+    pthread_mutex_unlock(&mutex);
+  } else if (options::enforce_turn_type == 4) {  // Futex relay.
+    /** Back to FUTEX_IDLE, so that post() makes no syscall if the owner is
+    still spinning by then. **/
+    if (futex == FUTEX_PARKED &&
+        __sync_bool_compare_and_swap(&futex, FUTEX_PARKED, FUTEX_IDLE))
+      syscall(SYS_futex, &futex, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+  }
+  // The semaphore and busy relays have nothing to wake up early.
+}
+
 //@before with turn
 //@after with turn
 unsigned RRScheduler::nextTimeout()
 {
-  unsigned next_timeout = FOREVER;
-  list<int>::iterator i;
-  for(i=waitq.begin(); i!=waitq.end(); ++i) {
-    int t = *i;
-    if(waits[t].timeout < next_timeout)
-      next_timeout = waits[t].timeout;
-  }
-  return next_timeout;
+  return waitq.next_timeout();
+}
+
+//@before with turn
+//@after with turn
+void RRScheduler::wakeWaiter(run_queue::runq_elem *elem, int status)
+{
+  waits[elem->tid].status = status;
+  runq.push_back(elem->tid);
 }
 
 //@before with turn
 //@after with turn
 int RRScheduler::fireTimeouts()
 {
-  int timedout = 0;
-  list<int>::iterator prv, cur;
-  // use delete-safe way of iterating the list
-  for(cur=waitq.begin(); cur!=waitq.end();) {
-    prv = cur ++;
-
-    int tid = *prv;
-    assert(tid >=0 && tid < Scheduler::nthread);
-    if(waits[tid].timeout < turnCount) {
-      dprintf("RRScheduler: %d timed out (%p, %u)\n",
-              tid, waits[tid].chan, waits[tid].timeout);
-      waits[tid].reset(ETIMEDOUT);
-      waitq.erase(prv);
-      runq.push_back(tid);
-      ++ timedout;
-    }
+  // fast path: the timeout index says nothing is due
+  if(waitq.next_timeout() >= turnCount)
+    return 0;
+
+  // expired threads come back in the order they started waiting, which is
+  // deterministic
+  timedout_elems.clear();
+  int timedout = (int)waitq.pop_expired(turnCount, timedout_elems);
+  for(int i = 0; i < timedout; ++i) {
+    run_queue::runq_elem *elem = timedout_elems[i];
+    assert(elem->tid >=0 && elem->tid < Scheduler::nthread);
+    dprintf("RRScheduler: %d timed out (%u)\n", elem->tid, elem->wait_timeout);
+    wakeWaiter(elem, ETIMEDOUT);
   }
   SELFCHECK;
   return timedout;
@@ -155,9 +236,18 @@ int RRScheduler::fireTimeouts()
 
 void RRScheduler::check_wakeup()
 {
-  if (inter_pro_wakeup_flag) {
-    pthread_mutex_lock(&inter_pro_wakeup_mutex);
-    for (tid_set::iterator itr = inter_pro_wakeup_tids.begin(); itr != inter_pro_wakeup_tids.end(); ++itr) {
+  if (inter_pro_wakeup_head) {
+    struct run_queue::runq_elem *elem =
+      __sync_lock_test_and_set(&inter_pro_wakeup_head, (struct run_queue::runq_elem *)NULL);
+    inter_pro_wakeup_tids.clear();
+    for (; elem; elem = elem->wake_next) {
+      inter_pro_wakeup_tids.push_back(elem->tid);
+      // Read wake_next before clearing the flag: once cleared, the owner may push the element again.
+      __sync_synchronize();
+      elem->wake_pending = 0;
+    }
+    std::sort(inter_pro_wakeup_tids.begin(), inter_pro_wakeup_tids.end());
+    for (std::vector<int>::iterator itr = inter_pro_wakeup_tids.begin(); itr != inter_pro_wakeup_tids.end(); ++itr) {
       // This runq.in() call is safe, because check_wakeup() can only be called by 
       // the thread holding the turn.
       if (!runq.in(*itr)) {
@@ -169,9 +259,6 @@ void RRScheduler::check_wakeup()
         }
       }
     }
-    inter_pro_wakeup_tids.clear();
-    inter_pro_wakeup_flag = false;
-    pthread_mutex_unlock(&inter_pro_wakeup_mutex);
   }
 }
 
@@ -215,28 +302,64 @@ void RRScheduler::next(bool at_thread_end, bool hasPoppedFront)
   waits[next_tid].post();
 }
 
+//@before with turn, runq empty
+//@after with turn
+bool RRScheduler::refillRunq() {
+  check_wakeup();
+  if (!runq.empty())
+    return true;
+  if (options::enforce_non_det_annotations && nNonDetWait > 0 &&
+      waitq.pop_all((void*)&nonDetCV, runq) > 0) {
+    dprintf("refillRunq() Tid %d wakes up nonDet start threads\n", self());
+    return true;
+  }
+  // Nobody is left to advance turnCount, so jump to the next timeout;
+  // which timeout that is does not depend on timing.
+  unsigned timeout = nextTimeout();
+  if (timeout != FOREVER) {
+    if (turnCount <= timeout)
+      turnCount = timeout + 1;
+    fireTimeouts();
+    assert(!runq.empty());
+    return true;
+  }
+  return false;
+}
+
+//@before with turn, runq empty
+//@after with turn if returning false, without turn otherwise
+bool RRScheduler::parkToken() {
+  token_parked = 1;
+  __sync_synchronize();
+  if (!inter_pro_wakeup_head)
+    return true;
+  // A thread came back meanwhile. Keep the token and drain it, unless that
+  // thread has already taken the token.
+  return !__sync_bool_compare_and_swap(&token_parked, 1, 0);
+}
+
+//@before without turn (token just taken from parkToken())
+//@after without turn
+void RRScheduler::reclaimToken() {
+  dprintf("RRScheduler: %d reclaims the parked token\n", self());
+  check_wakeup();
+  int next_tid = nextRunnable();
+  if (next_tid == InvalidTid)
+    return;
+  assert(next_tid>=0 && next_tid < Scheduler::nthread);
+  waits[next_tid].post();
+}
+
 void RRScheduler::wakeUpIdleThread() {
-  int tid = -1;
   if (idle_done) {
     fprintf(stderr, "WARN: idle thread is done, but tid %d is still running (for example, in OpenMP). Exit too.\n", self());
     fflush(stderr);
     pthread_exit(0);
   }
-  list<int>::iterator prv, cur;
-  // use delete-safe way of iterating the list
-  for(cur=waitq.begin(); cur!=waitq.end();) {
-    prv = cur ++;
-
-    tid = *prv;
-    assert(tid >=0 && tid < Scheduler::nthread);
-    if(tid == IdleThreadTid) {
-      waits[tid].reset();
-      waitq.erase(prv);
-      runq.push_back(tid);
-      break;
-    }
-  }
-  assert(tid == IdleThreadTid);
+  run_queue::runq_elem *idle = runq.get_my_elem(IdleThreadTid);
+  assert(idle && waitq.in(idle));
+  waitq.erase(idle);
+  wakeWaiter(idle, 0);
   assert(!runq.empty());
   pthread_mutex_lock(&idle_mutex);
   pthread_cond_signal(&idle_cond);
@@ -253,11 +376,13 @@ void RRScheduler::idleThreadCondWait() {
   if (tryPutTurn()) {
     int tid = self();
     assert(tid == IdleThreadTid);
-    waits[tid].chan = (void *)&idle_cond;
-    waits[tid].timeout = FOREVER;
-    waitq.push_back(tid);
     assert(tid == runq.front());
-    next();
+    run_queue::runq_elem *my = runq.get_my_elem(tid);
+    my->status = run_queue::RUNNABLE;
+    runq.pop_front();
+    waits[tid].status = 0;
+    waitq.push_back(my, (void *)&idle_cond, FOREVER);
+    next(false, true);
     pthread_cond_wait(&idle_cond, &idle_mutex);
   } else 
     putTurn();  // TBD: this seems not that nice, need refactored. Refer to record-runtime.
@@ -269,11 +394,35 @@ void RRScheduler::getTurn()
 {
   int tid = self();
   assert(tid>=0 && tid < Scheduler::nthread);
+  if (waits[tid].kept) { // see putTurn()
+    waits[tid].kept = false;
+    return;
+  }
   waits[tid].wait();
+  waits[tid].quantumOps = 0;
   dprintf("RRScheduler: %d gets turn\n", self());
+  if (options::prewake_depth > 0)
+    prewakeNext();
   SELFCHECK;
 }
 
+//@before with turn
+//@after with turn
+void RRScheduler::prewakeNext()
+{
+  /** The threads right after us on runq are the ones the turn goes to next,
+  unless we wait or wake threads up. Waking them up now overlaps their
+  wakeup latency with our operation. **/
+  int n = 0;
+  for (run_queue::iterator th = runq.begin();
+       th != runq.end() && n < options::prewake_depth; ++th) {
+    if (*th == self() || th->status == run_queue::INTER_PRO_STOP)
+      continue;
+    waits[*th].prewake();
+    n++;
+  }
+}
+
 int RRScheduler::block()
 {
   getTurn();
@@ -290,10 +439,22 @@ int RRScheduler::block()
 
 void RRScheduler::wakeup()
 {
-  pthread_mutex_lock(&inter_pro_wakeup_mutex);
-  inter_pro_wakeup_tids.insert(self());
-  inter_pro_wakeup_flag = true;
-  pthread_mutex_unlock(&inter_pro_wakeup_mutex);
+  struct run_queue::runq_elem *elem = runq.get_my_elem(self());
+  // Already on the list and not drained yet: nothing to do.
+  if (!__sync_bool_compare_and_swap(&elem->wake_pending, 0, 1))
+    return;
+  struct run_queue::runq_elem *head;
+  do {
+    head = inter_pro_wakeup_head;
+    elem->wake_next = head;
+  } while (!__sync_bool_compare_and_swap(&inter_pro_wakeup_head, head, elem));
+
+  // Without an idle thread the token may be parked; whoever comes back first
+  // takes it. The CAS above is a full barrier, so either this thread sees
+  // the flag or the parking thread sees the element pushed above.
+  if (!options::launch_idle_thread && token_parked &&
+      __sync_bool_compare_and_swap(&token_parked, 1, 0))
+    reclaimToken();
 }
 
 //@before with turn
@@ -305,12 +466,17 @@ void RRScheduler::putTurn(bool at_thread_end)
   assert(tid == runq.front());
   bool hasPoppedFront = false;
 
+  if(!at_thread_end && keepTurn(tid)) {
+    waits[tid].kept = true;
+    return;
+  }
+
   if(at_thread_end) {
     signal((void*)pthread_self());
     Parent::zombify(pthread_self());
     dprintf("RRScheduler: %d ends\n", self());
   } else {
-    // Check and modify "my" run queue element. No need to grab element spinlock since I am the head.
+    // Check and modify "my" run queue element. A plain store suffices: nobody CASes the status of the head.
     struct run_queue::runq_elem *my = runq.get_my_elem(tid);
     // Current if branch can not be taken (hasPoppedFront is false) if a thread
     // is doing network operation, so current status must be RUNNING_REG.
@@ -330,23 +496,92 @@ void RRScheduler::putTurn(bool at_thread_end)
   next(at_thread_end, hasPoppedFront);
 }
 
+/** With only the turn holder on @runq, putTurn() would pop it, push it
+back and post its own wait_t, and its next getTurn() would consume that
+post. The holder just keeps the turn instead. This is the common case
+while the program has a single thread (before the first pthread_create,
+and after the last join; the idle thread parks itself on idle_cond then),
+and whenever all other threads wait. It depends only on @runq, which is
+changed with turn held, so it does not change the schedule: the first
+thread created or woken, or a timeout fired by incTurnCount(), puts a
+second thread on @runq, and the next putTurn() passes the turn as usual.
+Inter-process wakeups not drained yet and the non-det bound take the
+normal path, which handles them.
+
+With a turn quantum, the holder also keeps the turn for up to
+turn_quantum consecutive operations while others are runnable; it gives
+it up earlier only by waiting (wait(), block()) or ending. The count of
+operations is a function of what the thread did, so the schedule stays
+deterministic. **/
+//@before with turn
+//@after with turn
+bool RRScheduler::keepTurn(int tid)
+{
+  if (options::launch_idle_thread && tid == IdleThreadTid)
+    return false; // idle_cond_wait() relies on passing the turn around
+  if (idle_done)
+    return false; // __tern_prog_end() waits for the idle thread with real pthread calls
+  if (options::enforce_non_det_clock_bound && non_det_thds.size() > 0)
+    return false;
+  if (options::solo_fast_path && runq.size() == 1 && !inter_pro_wakeup_head)
+    return true;
+  if (options::turn_quantum <= 1 || ++waits[tid].quantumOps >= options::turn_quantum)
+    return false;
+  return !idleAwake();
+}
+
+/// whether the idle thread is off idle_cond, i.e., runnable. It parks there
+/// again at its next turn (unless it is alone), and __tern_prog_end()
+/// relies on finding it parked, so a thread must not hold the turn from it.
+//@before with turn
+//@after with turn
+bool RRScheduler::idleAwake()
+{
+  if (!options::launch_idle_thread || Scheduler::nthread <= IdleThreadTid)
+    return false;
+  run_queue::runq_elem *idle = runq.get_my_elem(IdleThreadTid);
+  return idle && !waitq.in(idle);
+}
+
 //@before with turn
 //@after with turn
 int RRScheduler::wait(void *chan, unsigned nturn)
+{
+  return waitOn(chan, nturn, NULL);
+}
+
+//@before with turn
+//@after with turn
+int RRScheduler::waitList(wait_queue::list_t &l, unsigned nturn)
+{
+  return waitOn(l.chan, nturn, &l);
+}
+
+int RRScheduler::waitOn(void *chan, unsigned nturn, wait_queue::list_t *l)
 {
   record_rdtsc_op("RRScheduler::wait", "START", 2, NULL); // record rdtsc, disabled by default, no performance impact.
   incTurnCount();
   int tid = self();
   assert(tid>=0 && tid < Scheduler::nthread);
   assert(tid == runq.front());
-  waits[tid].chan = chan;
-  waits[tid].timeout = nturn;
-  waitq.push_back(tid);
+  // unlink self from runq before parking on @chan's wait queue, which
+  // reuses the runq links
+  run_queue::runq_elem *my = runq.get_my_elem(tid);
+  assert(my->status == run_queue::RUNNING_REG);
+  my->status = run_queue::RUNNABLE;
+  runq.pop_front();
+  waits[tid].status = 0;
+  waits[tid].waiting = true;
+  if (l)
+    waitq.push_back(my, *l, nturn);
+  else
+    waitq.push_back(my, chan, nturn);
   dprintf("RRScheduler: %d waits on (%p, %u)\n", tid, chan, nturn);
 
-  next();
+  next(false, true);
 
   getTurn();
+  waits[tid].waiting = false;
   record_rdtsc_op("RRScheduler::wait", "END", 2, NULL); // record rdtsc, disabled by default, no performance impact.
   return waits[tid].status;
 }
@@ -355,35 +590,101 @@ int RRScheduler::wait(void *chan, unsigned nturn)
 //@after with turn
 std::list<int> RRScheduler::signal(void *chan, bool all)
 {
-  list<int>::iterator prv, cur;
   std::list<int> signal_list;
   assert(chan && "can't signal/broadcast NULL");
   assert(self() == runq.front());
   dprintf("RRScheduler: %d: %s %p\n",
           self(), (all?"broadcast":"signal"), chan);
 
-  // use delete-safe way of iterating the list in case @all is true
-  for(cur=waitq.begin(); cur!=waitq.end();) {
-    prv = cur ++;
-
-    int tid = *prv;
-    assert(tid >=0 && tid < Scheduler::nthread);
-    if(waits[tid].chan == chan) {
+  if(all) {
 #ifdef XTERN_PLUS_DBUG
-      signal_list.push_back(tid);
+    size_t nrunnable = runq.size();
 #endif
-      dprintf("RRScheduler: %d signals %d(%p)\n", self(), tid, chan);
-      waits[tid].reset();
-      waitq.erase(prv);
-      runq.push_back(tid);
-      if(!all)
-        break;
+    // waiters already have status 0 (set in wait()), so the whole FIFO
+    // can be spliced onto runq without visiting each thread
+    size_t n = waitq.pop_all(chan, runq);
+    (void)n; // only for dprintf
+    dprintf("RRScheduler: %d broadcasts %lu threads (%p)\n", self(), (unsigned long)n, chan);
+#ifdef XTERN_PLUS_DBUG
+    run_queue::iterator th = runq.begin();
+    for(size_t i = 0; i < nrunnable; ++i)
+      ++th;
+    for(; th != runq.end(); ++th)
+      signal_list.push_back(*th);
+#endif
+  } else {
+    run_queue::runq_elem *elem = waitq.pop_front(chan);
+    if(elem) {
+      assert(elem->tid >=0 && elem->tid < Scheduler::nthread);
+#ifdef XTERN_PLUS_DBUG
+      signal_list.push_back(elem->tid);
+#endif
+      dprintf("RRScheduler: %d signals %d(%p)\n", self(), elem->tid, chan);
+      wakeWaiter(elem, 0);
     }
   }
   SELFCHECK;
   return signal_list;
 }
 
+//@before with turn
+//@after with turn
+size_t RRScheduler::signalList(wait_queue::list_t &l)
+{
+  assert(self() == runq.front());
+  // like signal(chan, true): one splice, no channel lookup
+  size_t n = waitq.pop_all(l, runq);
+  dprintf("RRScheduler: %d broadcasts %lu threads (%p)\n", self(), (unsigned long)n, (void *)&l);
+  SELFCHECK;
+  return n;
+}
+
+//@before with turn
+//@after with turn
+int RRScheduler::signalFirst(void *chan)
+{
+  assert(chan && "can't signal NULL");
+  assert(self() == runq.front());
+  run_queue::runq_elem *elem = waitq.pop_front(chan);
+  if(!elem)
+    return InvalidTid;
+  assert(elem->tid >=0 && elem->tid < Scheduler::nthread);
+  dprintf("RRScheduler: %d signals %d(%p)\n", self(), elem->tid, chan);
+  wakeWaiter(elem, 0);
+  SELFCHECK;
+  return elem->tid;
+}
+
+//@before with turn
+//@after with turn
+size_t RRScheduler::numWaiters(void *chan)
+{
+  assert(self() == runq.front());
+  return waitq.num_waiters(chan);
+}
+
+//@before with turn
+//@after with turn
+bool RRScheduler::isWaiting(int tid)
+{
+  assert(tid >= 0 && tid < Scheduler::nthread);
+  return waits[tid].waiting;
+}
+
+//@before with turn
+//@after with turn
+size_t RRScheduler::transfer(void *chan, void *to, bool all)
+{
+  assert(chan && to && "can't transfer from/to NULL");
+  assert(self() == runq.front());
+  // waiters keep their wait() return value (0, set in wait()), and are
+  // woken by a later signal(@to) in the order they were moved
+  size_t n = waitq.transfer(chan, to, all);
+  dprintf("RRScheduler: %d moves %lu threads from %p to %p\n", self(), (unsigned long)n, chan, to);
+  SELFCHECK;
+  return n;
+}
+
 //@before with turn
 //@after with turn
 unsigned RRScheduler::incTurnCount(void)
@@ -399,10 +700,52 @@ unsigned RRScheduler::getTurnCount(void)
   return Serializer::getTurnCount();
 }
 
+void RRScheduler::getRelayStat(long &nSpins, long &nParks, long long &nSpinNs)
+{
+  // the owners may be updating their counters right now
+  for(int i=0; i<Scheduler::nthread; ++i) {
+    nSpins += __sync_fetch_and_add(&waits[i].nSpins, 0);
+    nParks += __sync_fetch_and_add(&waits[i].nParks, 0);
+    nSpinNs += __sync_fetch_and_add(&waits[i].nSpinNs, 0);
+  }
+}
+
+//@before with turn
+//@after with turn
+unsigned RRScheduler::warpToNextTimeout()
+{
+  assert(self() == IdleThreadTid && self() == runq.front());
+  // Only the idle thread is runnable, so nothing but a timeout can change
+  // the schedule before nextTimeout(): skipping the turns in between is
+  // deterministic. Threads coming back from blocking calls, waiting in
+  // non-det regions, or bounded by the non-det clock need those turns.
+  if (runq.size() != 1 || inter_pro_wakeup_head)
+    return 0;
+  if (options::enforce_non_det_annotations && nNonDetWait > 0)
+    return 0;
+  if (options::enforce_non_det_clock_bound && non_det_thds.size() > 0)
+    return 0;
+  unsigned timeout = nextTimeout();
+  if (timeout == FOREVER || timeout <= turnCount)
+    return 0;
+  unsigned skipped = timeout - turnCount;
+  turnCount = timeout; // the next incTurnCount() fires this timeout
+  dprintf("RRScheduler: idle thread warps %u turns to %u\n", skipped, timeout);
+  return skipped;
+}
+
 void RRScheduler::childForkReturn() {
   Parent::childForkReturn();
-  for(int i=0; i<MAX_THREAD_NUM; ++i)
-    waits[i].reset();
+  for(int i=0; i<waits.size(); ++i)
+    if(waits.has(i))
+      waits[i].reset();
+}
+
+//@before with turn
+//@after with turn
+void RRScheduler::create(pthread_t new_th) {
+  Parent::create(new_th);
+  waits.ensure(getTid(new_th)).reset(); // the tid may be a recycled one
 }
 
 
@@ -414,12 +757,12 @@ RRScheduler::RRScheduler()
   assert(self() == MainThreadTid && "tid hasn't been initialized!");
   struct run_queue::runq_elem *main_elem = runq.create_thd_elem(MainThreadTid);
   runq.push_back(self());
+  waits.ensure(MainThreadTid);
   waits[MainThreadTid].post(); // Assign an initial turn to main thread.
   main_elem->status = run_queue::RUNNING_REG;// Assign an initial running state (i.e., turn) to main thread.
 
-  inter_pro_wakeup_tids.clear();
-  inter_pro_wakeup_flag = 0;
-  pthread_mutex_init(&inter_pro_wakeup_mutex, NULL);
+  inter_pro_wakeup_head = NULL;
+  token_parked = 0;
 }
 
 void RRScheduler::selfcheck(void)
@@ -441,7 +784,9 @@ void RRScheduler::selfcheck(void)
   }
 
   // no duplicate tids on waitq
-  for(list<int>::iterator th=waitq.begin(); th!=waitq.end(); ++th) {
+  list<int> waiters;
+  waitq.get_tids(waiters);
+  for(list<int>::iterator th=waiters.begin(); th!=waiters.end(); ++th) {
     if(*th < 0 || *th > Scheduler::nthread) {
       dump(cerr);
       assert(0 && "invalid tid on waitq!");
@@ -455,19 +800,18 @@ void RRScheduler::selfcheck(void)
 
   // TODO: check that tids have all tids
 
-  // threads on runq have NULL chan or non-forever timeout
+  // threads on runq are not in any wait queue
   for(run_queue::iterator th=runq.begin(); th!=runq.end(); ++th)
-    if(waits[*th].chan != NULL || waits[*th].timeout != FOREVER) {
+    if(waitq.in(&th)) {
       dump(cerr);
-      assert(0 && "thread on runq but has non-NULL chan "\
-             "or non-zero turns left!");
+      assert(0 && "thread on runq but also on waitq!");
     }
 
-  // threads on waitq have non-NULL waitvars or non-zero timeout
-  for(list<int>::iterator th=waitq.begin(); th!=waitq.end(); ++th)
-    if(waits[*th].chan == NULL && waits[*th].timeout == FOREVER) {
+  // threads on waitq have non-NULL waitvars
+  for(list<int>::iterator th=waiters.begin(); th!=waiters.end(); ++th)
+    if(runq.get_my_elem(*th)->wait_chan == NULL) {
       dump(cerr);
-      assert (0 && "thread on waitq but has NULL chan and 0 turn left!");
+      assert (0 && "thread on waitq but has NULL chan!");
     }
 }
 
@@ -478,35 +822,42 @@ ostream& RRScheduler::dump(ostream& o)
   copy(runq.begin(), runq.end(), ostream_iterator<int>(o, " "));
   o << "]";
   o << " [waitq ";
-  for(list<int>::iterator th=waitq.begin(); th!=waitq.end(); ++th)
-    o << *th << "(" << waits[*th].chan << "," << waits[*th].timeout << ") ";
+  list<int> waiters;
+  waitq.get_tids(waiters);
+  for(list<int>::iterator th=waiters.begin(); th!=waiters.end(); ++th) {
+    run_queue::runq_elem *elem = runq.get_my_elem(*th);
+    o << *th << "(" << elem->wait_chan << "," << elem->wait_timeout << ") ";
+  }
   o << "]\n";
   return o;
 }
 
+/** The status of a run queue element changes without locks. Only two
+threads may race on it: the owner thread, which moves it out of RUNNABLE
+(interProStart()), and the head thread, which passes the turn to it
+(RUNNABLE -> RUNNING_REG in nextRunnable() or tryPutTurn()). Both use
+compare-and-swap on RUNNABLE, so exactly one of them wins; every other
+transition is done by the only thread that can make it. **/
 bool RRScheduler::interProStart() {
-  bool isHead = true;
   struct run_queue::runq_elem *elem = runq.get_my_elem(self());
 
-  pthread_spin_lock(&elem->spin_lock);
-  if (elem->status == run_queue::RUNNABLE) {
-    isHead = false;
-    elem->status = run_queue::INTER_PRO_STOP;
-  } else {
-    assert(elem->status == run_queue::RUNNING_REG);
-    elem->status = run_queue::RUNNING_INTER_PRO;
+  while (true) {
+    if (elem->cas_status(run_queue::RUNNABLE, run_queue::INTER_PRO_STOP))
+      return false;
+    // The head has passed me the turn, so nobody else changes my status now.
+    if (elem->cas_status(run_queue::RUNNING_REG, run_queue::RUNNING_INTER_PRO))
+      return true;
+    // Both failed: the head moved me between the two, or my status is broken.
+    int status = elem->status;
+    assert((status == run_queue::RUNNABLE || status == run_queue::RUNNING_REG) &&
+           "interProStart() twice, or without interProEnd()");
   }
-  pthread_spin_unlock(&elem->spin_lock);
-
-  return isHead;
 }
 
 bool RRScheduler::interProEnd() {
   struct run_queue::runq_elem *elem = runq.get_my_elem(self());
-  pthread_spin_lock(&elem->spin_lock);
-  assert(elem->status == run_queue::INTER_PRO_STOP);
-  elem->status = run_queue::RUNNABLE;
-  pthread_spin_unlock(&elem->spin_lock);
+  bool ok = elem->cas_status(run_queue::INTER_PRO_STOP, run_queue::RUNNABLE);
+  assert(ok && "interProEnd() without interProStart()");
   return true;
 }
 
@@ -521,18 +872,20 @@ int RRScheduler::nextRunnable(bool at_thread_end) {
       // There are two special cases that: (1) at the thread end, waitq is empty, or 
       // (2) main thread exits (and waitq can be non-empty, e.g., openmp),
       // then just return an invalid tid.
-      if (at_thread_end && waitq.empty()) {
-        return InvalidTid;
-      } else if (at_thread_end && !waitq.empty() && self() == MainThreadTid) {
+      if (at_thread_end && !waitq.empty() && self() == MainThreadTid) {
         fprintf(stderr, "WARNING: main thread exits with some children threads alive (e.g., openmp).\n");
         return InvalidTid;
+      } else if (!options::launch_idle_thread) {
+        // Without an idle thread, threads in blocking calls are on neither
+        // queue, so even at the thread end the token must be parked for them.
+        if (refillRunq())
+          continue;
+        if (parkToken())
+          return InvalidTid;
+        continue;
+      } else if (at_thread_end && waitq.empty()) {
+        return InvalidTid;
       } else {
-        if (!options::launch_idle_thread) {
-          fprintf(stderr, "WARN: the program may contain some blocking network \
-            operations which requires 'options::launch_idle_thread = 1', please \
-            check your local.options file and rerun.\n");
-          exit(1);
-        }
         assert(self() != IdleThreadTid);
         wakeUpIdleThread();
       }
@@ -549,8 +902,11 @@ int RRScheduler::nextRunnable(bool at_thread_end) {
 
     // Process one head element.
     headElem = runq.front_elem();
-    pthread_spin_lock(&headElem->spin_lock);
-    if (headElem->status == run_queue::INTER_PRO_STOP) {
+    int status = headElem->status;
+    if (status == run_queue::RUNNABLE &&
+        !headElem->cas_status(run_queue::RUNNABLE, run_queue::RUNNING_REG))
+      continue; // the owner has just stopped for an inter-process operation; look again
+    if (status == run_queue::INTER_PRO_STOP) {
       /** If this thread is blocking, remove it from run queue
       and find the next one. The head thread is the only thread
       that could modify the linked list of run queue, so it is safe. **/
@@ -559,15 +915,12 @@ int RRScheduler::nextRunnable(bool at_thread_end) {
         non_det_thds.insert(headElem->tid, turnCount); // This operation is required by the bounded non-determinism mechanism.
     } else {
       dprintf("RRScheduler::nextRunnable at_thread_end %d, self %d, headElem tid %d, head status %d, self status %d\n",
-        at_thread_end, self(), headElem->tid, headElem->status, runq.get_my_elem(self())->status);
-      assert(headElem->status == run_queue::RUNNABLE ||
-        headElem->status == run_queue::RUNNING_REG || 
-        headElem->status == run_queue::RUNNING_INTER_PRO);
-      if (headElem->status == run_queue::RUNNABLE)
-        headElem->status = run_queue::RUNNING_REG;
+        at_thread_end, self(), headElem->tid, status, runq.get_my_elem(self())->status);
+      assert(status == run_queue::RUNNABLE ||
+        status == run_queue::RUNNING_REG || 
+        status == run_queue::RUNNING_INTER_PRO);
       passed = true;
     }
-    pthread_spin_unlock(&headElem->spin_lock);
  
     if (passed)
       break;
@@ -584,13 +937,9 @@ bool RRScheduler::tryPutTurn() {
   itr++; // Ignore myself.
   for (; itr != runq.end(); ++itr) {
     struct run_queue::runq_elem *cur = &itr;
-    pthread_spin_lock(&cur->spin_lock);
-    if (cur->status == run_queue::RUNNABLE) {
-      cur->status = run_queue::RUNNING_REG; // Try put turn succeeded.
-      pthread_spin_unlock(&cur->spin_lock);
-      return true;
-    }
-    pthread_spin_unlock(&cur->spin_lock);
+    if (cur->status == run_queue::RUNNABLE &&
+        cur->cas_status(run_queue::RUNNABLE, run_queue::RUNNING_REG))
+      return true; // Try put turn succeeded.
   }
   return false;
 }
@@ -31,6 +31,11 @@ public:
   long nLineupTimeout; /* Number of lineup timeouts. */
   long nNonDetRegions;  /* Number of times all threads entering the non-det regions (and exiting the regions must be the same value). */
   long nNonDetPthreadSync; /* Number of non-det pthread sync operations called within a non-det region. */
+  long nRelaySpins; /* Number of turn handoffs caught while spinning (hybrid and futex relays). */
+  long nRelayParks; /* Number of turn handoffs that had to sleep in the kernel. */
+  long long nRelaySpinNs; /* CPU time burned spinning for the turn, in nanoseconds (hybrid relay). */
+  long nPrivateSyncOp; /* Number of lock operations on thread-private mutexes, done without a turn (private_sync_fast_path). */
+  long nTurnFreeSyncOp; /* Number of init/destroy operations done without a turn (turn_free_init). */
   
 public:
   RuntimeStat() {
@@ -40,12 +45,18 @@ public:
     nLineupTimeout = 0;
     nNonDetRegions = 0;
     nNonDetPthreadSync = 0;    
+    nRelaySpins = 0;
+    nRelayParks = 0;
+    nRelaySpinNs = 0;
+    nPrivateSyncOp = 0;
+    nTurnFreeSyncOp = 0;
   }
   void print() {
     std::cout << "\n\nRuntimeStat:\n"
-      << "nDetPthreadSyncOp\t" << "nInterProcSyncOp\t" << "nLineupSucc\t" << "nLineupTimeout\t" << "nNonDetRegions\t" << "nNonDetPthreadSync\t" << "\n"    
+      << "nDetPthreadSyncOp\t" << "nInterProcSyncOp\t" << "nLineupSucc\t" << "nLineupTimeout\t" << "nNonDetRegions\t" << "nNonDetPthreadSync\t" << "nRelaySpins\t" << "nRelayParks\t" << "relaySpinCpuMs\t" << "nPrivateSyncOp\t" << "nTurnFreeSyncOp\t" << "\n"    
       << "RUNTIME_STAT: "
       << nDetPthreadSyncOp << "\t" << nInterProcSyncOp << "\t" << nLineupSucc << "\t" << nLineupTimeout << "\t" << nNonDetRegions << "\t" << nNonDetPthreadSync
+      << "\t" << nRelaySpins << "\t" << nRelayParks << "\t" << nRelaySpinNs / 1000000 << "\t" << nPrivateSyncOp << "\t" << nTurnFreeSyncOp
       << "\n\n" << std::flush;
   }
 
@@ -1186,6 +1186,22 @@ int Runtime::__sem_init(unsigned insid, int &error, sem_t *sem, int pshared, uns
   return ret;
 }
 
+int Runtime::__sem_destroy(unsigned insid, int &error, sem_t *sem) {
+  errno = error;
+  int ret;
+#ifdef XTERN_PLUS_DBUG
+  typedef int (*orig_func_type)(sem_t *sem);
+  static orig_func_type orig_func;
+  if (!orig_func)
+    orig_func = (orig_func_type)resolveDbugFunc("sem_destroy");
+  ret = orig_func(sem);
+#else
+  ret = sem_destroy(sem);
+#endif
+  error = errno;
+  return ret;
+}
+
 int Runtime::__sem_wait(unsigned insid, int &error, sem_t *sem) {
   errno = error;
   int ret;
@@ -1358,4 +1374,20 @@ int Runtime::__pthread_rwlock_init(unsigned ins, int &error, pthread_rwlock_t *r
   return ret; 
 }
 
+int Runtime::__pthread_rwlock_timedrdlock(unsigned ins, int &error, pthread_rwlock_t *rwlock, const struct timespec *abs_timeout) 
+{ 
+  error = errno; 
+  int ret = ::pthread_rwlock_timedrdlock(rwlock, abs_timeout); 
+  errno = error; 
+  return ret; 
+}
+
+int Runtime::__pthread_rwlock_timedwrlock(unsigned ins, int &error, pthread_rwlock_t *rwlock, const struct timespec *abs_timeout) 
+{ 
+  error = errno; 
+  int ret = ::pthread_rwlock_timedwrlock(rwlock, abs_timeout); 
+  errno = error; 
+  return ret; 
+}
+
 
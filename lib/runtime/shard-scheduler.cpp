@@ -0,0 +1,618 @@
+/* Copyright (c) 2013,  Regents of the Columbia University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "tern/runtime/shard-scheduler.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <errno.h>
+#include "tern/options.h"
+
+using namespace std;
+using namespace tern;
+
+//#define _DEBUG_SHARD
+
+#ifdef _DEBUG_SHARD
+#  define dprintf(fmt...) do {                   \
+     fprintf(stderr, "[%d] ", self());            \
+     fprintf(stderr, fmt);                       \
+     fflush(stderr);                             \
+   } while(0)
+#else
+#  define dprintf(fmt...) ;
+#endif
+
+ShardScheduler::ShardScheduler(): nshards(options::turn_shards),
+  by_domain(options::turn_domains > 1)
+{
+  assert(nshards > 1);
+  pthread_mutex_init(&state_lock, NULL);
+
+  // "0,1,-,2": one entry per thread in creation order, '-' for unset
+  const char *p = options::thread_domains.c_str();
+  if (options::thread_domains != "inherit") {
+    while (*p) {
+      char *end;
+      long d = strtol(p, &end, 10);
+      placement.push_back(end == p ? -1 : (int)(labs(d) % nshards));
+      p = strchr(p, ',');
+      if (!p)
+        break;
+      ++p;
+    }
+  }
+
+  // RRScheduler() gave the main thread the turn on @runq; it starts with
+  // the turn of its own shard instead, and the other shards wait for threads
+  int main_shard = placeThread(0, 0);
+  run_queue::runq_elem *main_elem = runq.get_my_elem(MainThreadTid);
+  runq.pop_front();
+  for (int s = 0; s < nshards; ++s) {
+    shard_t *sh = new shard_t;
+    sh->q.share_thd_elem(MainThreadTid, main_elem);
+    sh->nturns = sh->nrequests = 0;
+    sh->stopped = (s != main_shard);
+    shards.push_back(sh);
+  }
+  shards[main_shard]->q.push_back(MainThreadTid);
+  thd_t &t = thds.ensure(MainThreadTid);
+  t.shard = t.dest = main_shard;
+  t.serial = false;
+
+  next_request = 0;
+  serial_phase = false;
+  base = serial_clock = turnCount;
+  nstopped = nshards - 1;
+  ncreated = 0;
+}
+
+ShardScheduler::~ShardScheduler() {}
+
+int ShardScheduler::placeThread(unsigned n, int otherwise)
+{
+  if (n < placement.size() && placement[n] >= 0)
+    return placement[n];
+  return otherwise;
+}
+
+bool ShardScheduler::inShard(void *obj, int s)
+{
+  if (!obj)
+    return true;
+  sync_obj_t *o = syncObjects().find(obj);
+  return o && o->shard == s;
+}
+
+//@before without turn
+//@after with turn
+void ShardScheduler::getTurn()
+{
+  enter(true, NULL, NULL);
+}
+
+//@before without turn
+//@after with turn
+void ShardScheduler::getTurnOn(void *obj, void *obj2)
+{
+  enter(false, obj, obj2);
+}
+
+/** Wait for the shard's turn; run the operation there if it is local, or
+else ask for a slot in the serial phase and wait for it. **/
+void ShardScheduler::enter(bool serial, void *obj, void *obj2)
+{
+  int tid = self();
+  assert(tid>=0 && tid < Scheduler::nthread);
+  waits[tid].wait();
+  pthread_mutex_lock(&state_lock);
+  thd_t &me = thds[tid];
+  assert(!serial_phase && !me.serial);
+  int s = me.shard;
+  if (!serial && inShard(obj, s) && inShard(obj2, s)) {
+    dprintf("ShardScheduler: %d gets the turn of shard %d\n", tid, s);
+    return;
+  }
+
+  me.objs[0] = obj;
+  me.objs[1] = obj2;
+  request(tid);
+  run_queue::runq_elem *my = shards[s]->q.front_elem();
+  assert(my->tid == tid && my->status == run_queue::RUNNING_REG);
+  my->status = run_queue::RUNNABLE;
+  shards[s]->q.pop_front();
+  passShard(s);
+  pthread_mutex_unlock(&state_lock);
+
+  waits[tid].wait();
+  pthread_mutex_lock(&state_lock);
+  assert(serial_phase);
+  me.serial = true;
+  // the objects used for the first time belong to the caller's shard
+  int obj_shard[2] = {me.shard, me.shard};
+  for (int i = 0; i < 2; ++i)
+    if (me.objs[i]) {
+      sync_obj_t *o = syncObjects().find_or_create(me.objs[i]);
+      if (o->shard < 0)
+        o->shard = me.shard;
+      obj_shard[i] = o->shard;
+    }
+  // a domain keeps its threads; a shard gathers those sharing objects
+  me.dest = by_domain ? me.shard : obj_shard[0];
+  dprintf("ShardScheduler: %d gets the serial turn\n", tid);
+}
+
+//@before with turn
+//@after without turn
+void ShardScheduler::putTurn(bool at_thread_end)
+{
+  int tid = self();
+  thd_t &me = thds[tid];
+  int s = me.shard;
+  if (at_thread_end) {
+    signal((void*)pthread_self());
+    TidMap::zombify(pthread_self());
+    dprintf("ShardScheduler: %d ends\n", tid);
+  }
+  if (me.serial) {
+    me.serial = false;
+    if (!at_thread_end) {
+      me.shard = me.dest;
+      shards[me.shard]->q.push_back(tid);
+    }
+    passSerial();
+  } else {
+    run_queue &q = shards[s]->q;
+    assert(q.front() == tid);
+    run_queue::runq_elem *my = q.front_elem();
+    assert(my->status == run_queue::RUNNING_REG);
+    my->status = run_queue::RUNNABLE;
+    q.pop_front();
+    if (!at_thread_end)
+      q.push_back(tid);
+    passShard(s);
+  }
+  pthread_mutex_unlock(&state_lock);
+}
+
+//@before with turn
+//@after with turn
+int ShardScheduler::wait(void *chan, unsigned nturn)
+{
+  return waitOn(chan, nturn, NULL);
+}
+
+//@before with turn
+//@after with turn
+int ShardScheduler::waitList(wait_queue::list_t &l, unsigned nturn)
+{
+  return waitOn(l.chan, nturn, &l);
+}
+
+int ShardScheduler::waitOn(void *chan, unsigned nturn, wait_queue::list_t *l)
+{
+  incTurnCount();
+  int tid = self();
+  thd_t &me = thds[tid];
+  run_queue::runq_elem *my = runq.get_my_elem(tid);
+  if (!me.serial) {
+    run_queue &q = shards[me.shard]->q;
+    assert(q.front() == tid && my->status == run_queue::RUNNING_REG);
+    my->status = run_queue::RUNNABLE;
+    q.pop_front();
+  }
+  waits[tid].status = 0;
+  waits[tid].waiting = true;
+  if (l)
+    waitq.push_back(my, *l, nturn);
+  else
+    waitq.push_back(my, chan, nturn);
+  dprintf("ShardScheduler: %d waits on (%p, %u)%s\n", tid, chan, nturn, me.serial ? " serially" : "");
+
+  if (me.serial)
+    passSerial();
+  else
+    passShard(me.shard);
+  pthread_mutex_unlock(&state_lock);
+
+  waits[tid].wait();
+  pthread_mutex_lock(&state_lock);
+  waits[tid].waiting = false;
+  return waits[tid].status;
+}
+
+/** A serial waiter goes back to the serial phase; any other waiter to its
+shard, which is the waker's own one unless this is the serial phase. **/
+//@before with turn
+//@after with turn
+void ShardScheduler::wake(run_queue::runq_elem *elem, int status)
+{
+  int tid = elem->tid;
+  assert(tid >= 0 && tid < Scheduler::nthread);
+  waits[tid].status = status;
+  thd_t &t = thds[tid];
+  if (t.serial) {
+    request(tid);
+    return;
+  }
+  assert((serial_phase || t.shard == thds[self()].shard) &&
+         "a shard woke up a thread of another shard");
+  shards[t.shard]->q.push_back(tid);
+}
+
+void ShardScheduler::wakeAll(run_queue &q)
+{
+  while (!q.empty()) {
+    run_queue::runq_elem *elem = q.front_elem();
+    q.pop_front();
+    wake(elem, 0);
+  }
+}
+
+//@before with turn
+//@after with turn
+void ShardScheduler::request(int tid)
+{
+  request_t r;
+  r.tid = tid;
+  if (serial_phase) {
+    // behind all requests of the shards, in the order made
+    r.shard = nshards;
+    r.seq = 0;
+  } else {
+    shard_t *sh = shards[thds[self()].shard];
+    r.shard = thds[self()].shard;
+    r.seq = sh->nrequests++;
+  }
+  requests.push_back(r);
+}
+
+//@before with turn
+//@after with turn
+std::list<int> ShardScheduler::signal(void *chan, bool all)
+{
+  std::list<int> signal_list;
+  assert(chan && "can't signal/broadcast NULL");
+  if (all) {
+    waitq.pop_all(chan, woken);
+#ifdef XTERN_PLUS_DBUG
+    for (run_queue::iterator th = woken.begin(); th != woken.end(); ++th)
+      signal_list.push_back(*th);
+#endif
+    wakeAll(woken);
+  } else if (run_queue::runq_elem *elem = waitq.pop_front(chan)) {
+#ifdef XTERN_PLUS_DBUG
+    signal_list.push_back(elem->tid);
+#endif
+    wake(elem, 0);
+  }
+  return signal_list;
+}
+
+//@before with turn
+//@after with turn
+size_t ShardScheduler::signalList(wait_queue::list_t &l)
+{
+  size_t n = waitq.pop_all(l, woken);
+  wakeAll(woken);
+  return n;
+}
+
+//@before with turn
+//@after with turn
+int ShardScheduler::signalFirst(void *chan)
+{
+  assert(chan && "can't signal NULL");
+  run_queue::runq_elem *elem = waitq.pop_front(chan);
+  if (!elem)
+    return InvalidTid;
+  wake(elem, 0);
+  return elem->tid;
+}
+
+//@before with turn
+//@after with turn
+size_t ShardScheduler::numWaiters(void *chan)
+{
+  return waitq.num_waiters(chan);
+}
+
+//@before with turn
+//@after with turn
+size_t ShardScheduler::transfer(void *chan, void *to, bool all)
+{
+  assert(chan && to && "can't transfer from/to NULL");
+  return waitq.transfer(chan, to, all);
+}
+
+/// the thread moves when its serial operation ends; setDomain() takes the
+/// serial turn (getTurn()), as a thread can only leave a shard from there
+//@before with turn
+//@after with turn
+void ShardScheduler::setDomain(int domain)
+{
+  thd_t &me = thds[self()];
+  assert(me.serial);
+  me.dest = (int)(labs((long)domain) % nshards);
+  dprintf("ShardScheduler: %d moves to shard %d\n", self(), me.dest);
+}
+
+/// a new object at the same address belongs to its own first user
+//@before with turn
+//@after with turn
+void ShardScheduler::forgetSyncObj(void *obj)
+{
+  if (sync_obj_t *o = syncObjects().find(obj)) {
+    o->shard = -1;
+    syncObjects().release(o);
+  }
+}
+
+//@before with turn
+//@after with turn
+unsigned ShardScheduler::incTurnCount(void)
+{
+  unsigned ret;
+  if (serial_phase)
+    ret = serial_clock++;
+  else
+    ret = base + shards[thds[self()].shard]->nturns++;
+  if (options::log_sync)
+    fprintf(logger, "%d %d\n", (int) self(), ret);
+  return ret;
+}
+
+unsigned ShardScheduler::getTurnCount(void)
+{
+  if (serial_phase)
+    return serial_clock - 1;
+  return base + shards[thds[self()].shard]->nturns - 1;
+}
+
+/// like RRScheduler::nextRunnable() on the queue of shard @s; InvalidTid
+/// if none of its threads can run
+//@before with state_lock
+//@after with state_lock
+int ShardScheduler::nextInShard(int s)
+{
+  run_queue &q = shards[s]->q;
+  while (!q.empty()) {
+    run_queue::runq_elem *head = q.front_elem();
+    int status = head->status;
+    if (status == run_queue::RUNNABLE &&
+        !head->cas_status(run_queue::RUNNABLE, run_queue::RUNNING_REG))
+      continue; // the owner has just stopped for an inter-process operation
+    if (status == run_queue::INTER_PRO_STOP) {
+      q.pop_front(); // back through wakeup()
+      continue;
+    }
+    assert(status == run_queue::RUNNABLE);
+    return head->tid;
+  }
+  return InvalidTid;
+}
+
+/** Pass the turn of shard @s on, or stop the shard for this round; the
+last shard to stop starts the serial phase. **/
+//@before with state_lock, nobody holds the turn of shard @s
+//@after with state_lock
+void ShardScheduler::passShard(int s)
+{
+  shard_t *sh = shards[s];
+  assert(!sh->stopped);
+  if (sh->nturns < (unsigned)options::shard_round_turns) {
+    int tid = nextInShard(s);
+    if (tid != InvalidTid) {
+      dprintf("ShardScheduler: shard %d passes its turn to %d\n", s, tid);
+      waits[tid].post();
+      return;
+    }
+  }
+  sh->stopped = true;
+  dprintf("ShardScheduler: shard %d stops after %u turns\n", s, sh->nturns);
+  if (++nstopped == nshards)
+    beginSerial();
+}
+
+//@before with state_lock, all shards stopped
+//@after with state_lock
+void ShardScheduler::beginSerial()
+{
+  unsigned nturns = options::shard_round_turns;
+  for (int s = 0; s < nshards; ++s)
+    nturns = std::max(nturns, shards[s]->nturns);
+  serial_phase = true;
+  serial_clock = base + nturns;
+  // the requests came in in timing-dependent order; their keys did not
+  std::sort(requests.begin(), requests.end());
+  next_request = 0;
+  dprintf("ShardScheduler: serial phase at %u, %u requests\n",
+          serial_clock, (unsigned)requests.size());
+  passSerial();
+}
+
+/** Pass the serial turn to the next request; when none is left, start the
+next round. If no thread can run, jump to the next timeout, or park the
+token as RRScheduler does until a thread returns from a blocking call. **/
+//@before with state_lock, in the serial phase, nobody holds a turn
+//@after with state_lock
+void ShardScheduler::passSerial()
+{
+  while (true) {
+    if (next_request < requests.size()) {
+      int tid = requests[next_request++].tid;
+      dprintf("ShardScheduler: serial turn to %d\n", tid);
+      waits[tid].post();
+      return;
+    }
+    fireShardTimeouts();
+    drainWakeups();
+    if (next_request < requests.size())
+      continue;
+    if (startRound())
+      return;
+    unsigned timeout = nextTimeout();
+    if (timeout != FOREVER) {
+      if (serial_clock <= timeout)
+        serial_clock = timeout + 1;
+      continue;
+    }
+    if (parkToken())
+      return;
+  }
+}
+
+//@before with state_lock, in the serial phase, no request left
+//@after with state_lock; false if no shard has a thread to run
+bool ShardScheduler::startRound()
+{
+  requests.clear();
+  next_request = 0;
+  serial_phase = false;
+  base = serial_clock;
+  nstopped = 0;
+  for (int s = 0; s < nshards; ++s) {
+    shard_t *sh = shards[s];
+    sh->nturns = sh->nrequests = 0;
+    int tid = nextInShard(s);
+    sh->stopped = (tid == InvalidTid);
+    if (sh->stopped)
+      nstopped++;
+    else
+      waits[tid].post();
+  }
+  if (nstopped < nshards) {
+    dprintf("ShardScheduler: round at %u\n", base);
+    return true;
+  }
+  serial_phase = true;
+  return false;
+}
+
+//@before with state_lock, in the serial phase
+//@after with state_lock
+void ShardScheduler::fireShardTimeouts()
+{
+  if (waitq.next_timeout() >= serial_clock)
+    return;
+  timedout_elems.clear();
+  size_t n = waitq.pop_expired(serial_clock, timedout_elems);
+  for (size_t i = 0; i < n; ++i)
+    wake(timedout_elems[i], ETIMEDOUT);
+}
+
+/// RRScheduler::check_wakeup() for the shard queues
+//@before with state_lock, in the serial phase
+//@after with state_lock
+void ShardScheduler::drainWakeups()
+{
+  if (!inter_pro_wakeup_head)
+    return;
+  run_queue::runq_elem *elem =
+    __sync_lock_test_and_set(&inter_pro_wakeup_head, (run_queue::runq_elem *)NULL);
+  inter_pro_wakeup_tids.clear();
+  for (; elem; elem = elem->wake_next) {
+    inter_pro_wakeup_tids.push_back(elem->tid);
+    __sync_synchronize();
+    elem->wake_pending = 0;
+  }
+  std::sort(inter_pro_wakeup_tids.begin(), inter_pro_wakeup_tids.end());
+  for (size_t i = 0; i < inter_pro_wakeup_tids.size(); ++i) {
+    int tid = inter_pro_wakeup_tids[i];
+    run_queue &q = shards[thds[tid].shard]->q;
+    if (!q.in(tid))
+      q.push_back(tid);
+  }
+}
+
+/// the token was parked in passSerial()
+//@before without turn
+//@after without turn
+void ShardScheduler::reclaimToken()
+{
+  pthread_mutex_lock(&state_lock);
+  dprintf("ShardScheduler: %d reclaims the parked token\n", self());
+  passSerial();
+  pthread_mutex_unlock(&state_lock);
+}
+
+//@before without turn
+//@after without turn
+int ShardScheduler::block()
+{
+  int tid = self();
+  waits[tid].wait();
+  pthread_mutex_lock(&state_lock);
+  thd_t &me = thds[tid];
+  assert(!serial_phase && !me.serial);
+  run_queue &q = shards[me.shard]->q;
+  assert(q.front() == tid);
+  int ret = incTurnCount();
+  run_queue::runq_elem *my = q.front_elem();
+  assert(my->status == run_queue::RUNNING_INTER_PRO);
+  my->status = run_queue::INTER_PRO_STOP;
+  q.pop_front();
+  dprintf("ShardScheduler: %d blocks\n", tid);
+  passShard(me.shard);
+  pthread_mutex_unlock(&state_lock);
+  return ret;
+}
+
+//@before with turn
+//@after with turn
+void ShardScheduler::create(pthread_t new_th)
+{
+  TidMap::create(new_th);
+  int tid = getTid(new_th);
+  run_queue::runq_elem *elem = runq.create_thd_elem(tid);
+  waits.ensure(tid).reset(); // the tid may be a recycled one
+  for (int s = 0; s < nshards; ++s)
+    shards[s]->q.share_thd_elem(tid, elem);
+  thd_t &t = thds.ensure(tid);
+  ++ncreated;
+  t.shard = t.dest = placeThread(ncreated, by_domain ?
+                                 thds[self()].shard : (int)(ncreated % nshards));
+  t.serial = false;
+  shards[t.shard]->q.push_back(tid);
+}
+
+/// the child runs the rest of fork() as the serial phase's only request
+void ShardScheduler::childForkReturn()
+{
+  Parent::childForkReturn();
+  run_queue::runq_elem *main_elem = runq.get_my_elem(MainThreadTid);
+  runq.pop_front();
+  main_elem->status = run_queue::RUNNABLE;
+  for (int s = 0; s < nshards; ++s) {
+    delete shards[s];
+    shards[s] = new shard_t;
+    shards[s]->q.share_thd_elem(MainThreadTid, main_elem);
+    shards[s]->nturns = shards[s]->nrequests = 0;
+    shards[s]->stopped = true;
+  }
+  thd_t &t = thds[MainThreadTid];
+  t.shard = t.dest = placeThread(0, 0);
+  t.serial = true;
+  requests.clear();
+  next_request = 0;
+  serial_phase = true;
+  nstopped = nshards;
+  ncreated = 0;
+  inter_pro_wakeup_head = NULL;
+  token_parked = 0;
+}
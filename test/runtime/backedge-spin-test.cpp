@@ -0,0 +1,68 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+// RUN: %srcroot/test/runtime/run-scheduler-test.py %s -gxx "%gxx" -llvmgcc "%llvmgcc" -projbindir "%projbindir" -ternruntime "%ternruntime" -ternannotlib "%ternannotlib"  -ternbcruntime "%ternbcruntime" -nondet
+
+// Main spins on a plain flag that the child sets, reporting each loop
+// back-edge with backedge_stat() as eval/find-hotspot would. Without
+// backedge_preempt the turn gets to main, which never takes it, so the
+// child cannot run until the spin gives up after N rounds; with it, main
+// passes the turn on every backedge_preempt back-edges and must see the
+// flag long before that. How many rounds main spins depends on timing,
+// hence -nondet.
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tern/user.h"
+
+#define N 1000000
+
+pthread_mutex_t mu = PTHREAD_MUTEX_INITIALIZER;
+volatile int flag = 0;
+
+void* thread_func(void*) {
+  pthread_mutex_lock(&mu);
+  flag = 1;
+  pthread_mutex_unlock(&mu);
+  return NULL;
+}
+
+int main(int argc, char *argv[], char *env[]) {
+  int ret;
+  pthread_t th;
+
+  ret = pthread_create(&th, NULL, thread_func, NULL);
+  assert(!ret && "pthread_create() failed!");
+
+  int i;
+  for (i = 0; i < N && !flag; ++i)
+    backedge_stat(1);
+
+  const char *opts = getenv("TERN_OPTIONS");
+  if (opts && strstr(opts, "backedge_preempt=") && !strstr(opts, "backedge_preempt=0"))
+    assert(i < N && "the spinning thread kept the turn");
+
+  ret = pthread_join(th, NULL);
+  assert(!ret && "pthread_join() failed!");
+  printf("flag %d\n", flag);
+  return 0;
+}
+
+// CHECK: flag 1
@@ -0,0 +1,83 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// RUN: %srcroot/test/runtime/run-scheduler-test.py %s -gxx "%gxx" -llvmgcc "%llvmgcc" -projbindir "%projbindir" -ternruntime "%ternruntime" -ternannotlib "%ternannotlib"  -ternbcruntime "%ternbcruntime"
+// RUN: %srcroot/test/runtime/run-scheduler-test.py %s -gxx "%gxx" -llvmgcc "%llvmgcc" -projbindir "%projbindir" -ternruntime "%ternruntime" -ternannotlib "%ternannotlib"  -ternbcruntime "%ternbcruntime"
+
+// Reuse a barrier for many rounds, and recycle barriers through
+// pthread_barrier_destroy() and pthread_barrier_init().
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <assert.h>
+
+#define N (4)
+#define ROUNDS (100)
+
+pthread_barrier_t ba;
+volatile int phase[N];
+int nserial = 0;
+int nerrors = 0;
+
+void* thread_func(void* arg) {
+  long id = (long)arg;
+  for(int r=0; r<ROUNDS; ++r) {
+    phase[id] = r + 1;
+    int ret = pthread_barrier_wait(&ba);
+    assert((ret == 0 || ret == PTHREAD_BARRIER_SERIAL_THREAD) && "pthread_barrier_wait() failed!");
+    if(ret == PTHREAD_BARRIER_SERIAL_THREAD)
+      __sync_fetch_and_add(&nserial, 1);
+    // nobody leaves round r before everybody has arrived
+    for(int i=0; i<N; ++i)
+      if(phase[i] < r + 1)
+        __sync_fetch_and_add(&nerrors, 1);
+  }
+  return NULL;
+}
+
+int main(int argc, char *argv[], char *env[]) {
+  int ret;
+  pthread_t th[N];
+
+  pthread_barrier_init(&ba, NULL, N);
+  for(long i=0; i<N; ++i) {
+    ret  = pthread_create(&th[i], NULL, thread_func, (void*)i);
+    assert(!ret && "pthread_create() failed!");
+  }
+  for(int i=0; i<N; ++i)
+    pthread_join(th[i], NULL);
+  ret = pthread_barrier_destroy(&ba);
+  assert(!ret && "pthread_barrier_destroy() failed!");
+  printf("serial %d errors %d\n", nserial, nerrors);
+
+  pthread_barrier_t ba2, ba3;
+  pthread_barrier_init(&ba2, NULL, 1);
+  pthread_barrier_init(&ba3, NULL, 1);
+  printf("ba2 %d ba3 %d\n", pthread_barrier_wait(&ba2) == PTHREAD_BARRIER_SERIAL_THREAD,
+         pthread_barrier_wait(&ba3) == PTHREAD_BARRIER_SERIAL_THREAD);
+  pthread_barrier_destroy(&ba2);
+  pthread_barrier_destroy(&ba3);
+
+  printf("done\n");
+  return 0;
+}
+
+// CHECK:      serial 100 errors 0
+// CHECK-NEXT: ba2 1 ba3 1
+// CHECK-NEXT: done
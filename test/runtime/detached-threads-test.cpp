@@ -0,0 +1,79 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+// RUN: %srcroot/test/runtime/run-scheduler-test.py %s -gxx "%gxx" -llvmgcc "%llvmgcc" -projbindir "%projbindir" -ternruntime "%ternruntime" -ternannotlib "%ternannotlib"  -ternbcruntime "%ternbcruntime"
+
+/* Detached threads, created detached or detached by pthread_detach(),
+   are never joined; they free their tids when they end, so the rounds
+   below reuse about N tids. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <assert.h>
+#include <stdint.h>
+
+#define ROUNDS (30)
+#define N (20)
+
+pthread_mutex_t m = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t cv = PTHREAD_COND_INITIALIZER;
+int count = 0;
+int done = 0;
+
+void* thread_func(void *arg) {
+  if ((intptr_t)arg % 3 == 0)
+    pthread_detach(pthread_self());
+  pthread_mutex_lock(&m);
+  count++;
+  done++;
+  pthread_cond_signal(&cv);
+  pthread_mutex_unlock(&m);
+  return NULL;
+}
+
+int main(int argc, char *argv[], char *env[]) {
+  int ret;
+  pthread_t th;
+  pthread_attr_t attr;
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  for(unsigned r=0; r<ROUNDS; ++r) {
+    for(unsigned i=0; i<N; ++i) {
+      if (i % 3 == 1) {
+        ret  = pthread_create(&th, &attr, thread_func, (void*)(intptr_t)i);
+        assert(!ret && "pthread_create() failed!");
+      } else {
+        ret  = pthread_create(&th, NULL, thread_func, (void*)(intptr_t)i);
+        assert(!ret && "pthread_create() failed!");
+        if (i % 3 == 2)
+          pthread_detach(th);
+      }
+    }
+    pthread_mutex_lock(&m);
+    while (done < N)
+      pthread_cond_wait(&cv, &m);
+    done = 0;
+    pthread_mutex_unlock(&m);
+  }
+  pthread_attr_destroy(&attr);
+  printf("%d threads ran\n", count);
+  return 0;
+}
+
+// CHECK: 600 threads ran
@@ -0,0 +1,89 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+// RUN: %srcroot/test/runtime/run-scheduler-test.py %s -gxx "%gxx" -llvmgcc "%llvmgcc" -projbindir "%projbindir" -ternruntime "%ternruntime" -ternannotlib "%ternannotlib"  -ternbcruntime "%ternbcruntime"
+
+// Two pools of threads, each with a mutex of its own, and one mutex both
+// pools update now and then. Each pool leader moves itself to a domain of
+// its own with tern_set_domain() before creating its workers, which start
+// in their creator's domain. With turn_domains, the pool mutexes are only
+// scheduled within their domain and the shared one through the serial
+// phase; no update may be lost either way.
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include "tern/user.h"
+
+#define NPOOLS 2
+#define NWORKERS 3
+#define N 200
+
+struct pool_t {
+  pthread_mutex_t mu;
+  int count;
+};
+
+pool_t pools[NPOOLS];
+pthread_mutex_t shared_mu = PTHREAD_MUTEX_INITIALIZER;
+int shared_count = 0;
+
+void* worker(void *arg) {
+  pool_t *pool = (pool_t *)arg;
+  for (int i = 0; i < N; ++i) {
+    pthread_mutex_lock(&pool->mu);
+    ++pool->count;
+    pthread_mutex_unlock(&pool->mu);
+    if (i % 50 == 0) {
+      pthread_mutex_lock(&shared_mu);
+      ++shared_count;
+      pthread_mutex_unlock(&shared_mu);
+    }
+  }
+  return NULL;
+}
+
+void* leader(void *arg) {
+  long p = (long)arg;
+  pthread_t th[NWORKERS];
+  tern_set_domain((int)p + 1);
+  for (int i = 0; i < NWORKERS; ++i) {
+    int ret = pthread_create(&th[i], NULL, worker, &pools[p]);
+    assert(!ret && "pthread_create() failed!");
+  }
+  for (int i = 0; i < NWORKERS; ++i)
+    pthread_join(th[i], NULL);
+  return NULL;
+}
+
+int main(int argc, char *argv[], char *env[]) {
+  pthread_t th[NPOOLS];
+  for (long p = 0; p < NPOOLS; ++p) {
+    pthread_mutex_init(&pools[p].mu, NULL);
+    pools[p].count = 0;
+  }
+  for (long p = 0; p < NPOOLS; ++p) {
+    int ret = pthread_create(&th[p], NULL, leader, (void *)p);
+    assert(!ret && "pthread_create() failed!");
+  }
+  for (long p = 0; p < NPOOLS; ++p)
+    pthread_join(th[p], NULL);
+  printf("pools %d %d shared %d\n", pools[0].count, pools[1].count, shared_count);
+  return 0;
+}
+
+// CHECK: pools 600 600 shared 24
@@ -0,0 +1,101 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// RUN: %srcroot/test/runtime/run-scheduler-test.py %s -gxx "%gxx" -llvmgcc "%llvmgcc" -projbindir "%projbindir" -ternruntime "%ternruntime" -ternannotlib "%ternannotlib"  -ternbcruntime "%ternbcruntime"
+
+// Threads keep initializing and destroying mutexes, rwlocks and semaphores
+// at the same addresses. With turn_free_init these calls skip the turn,
+// and the runtime must still see each object as new: a mutex initialized
+// as recursive after a normal one at the same address locks twice, and a
+// semaphore starts at its new value.
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+
+#define N 200
+#define T 2
+
+pthread_mutex_t total_mu = PTHREAD_MUTEX_INITIALIZER;
+int total = 0;
+int nbad = 0;
+
+void* thread_func(void*) {
+  int bad = 0;
+  for (int i = 0; i < N; ++i) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_t mu;
+    bool recursive = i % 2;
+    pthread_mutex_init(&mu, recursive ? &attr : NULL);
+    pthread_mutex_lock(&mu);
+    if (recursive) {
+      bad += pthread_mutex_trylock(&mu) != 0;
+      pthread_mutex_unlock(&mu);
+    } else
+      bad += pthread_mutex_trylock(&mu) != EBUSY;
+    pthread_mutex_unlock(&mu);
+    pthread_mutex_destroy(&mu);
+    pthread_mutexattr_destroy(&attr);
+
+    pthread_rwlock_t rw;
+    pthread_rwlock_init(&rw, NULL);
+    pthread_rwlock_rdlock(&rw);
+    bad += pthread_rwlock_trywrlock(&rw) != EBUSY;
+    pthread_rwlock_unlock(&rw);
+    pthread_rwlock_destroy(&rw);
+
+    sem_t sem;
+    sem_init(&sem, 0, i % 3);
+    int n = 0;
+    while (sem_trywait(&sem) == 0)
+      n++;
+    bad += n != i % 3;
+    sem_destroy(&sem);
+
+    pthread_mutex_lock(&total_mu);
+    ++total;
+    pthread_mutex_unlock(&total_mu);
+  }
+  pthread_mutex_lock(&total_mu);
+  nbad += bad;
+  pthread_mutex_unlock(&total_mu);
+  return NULL;
+}
+
+int main(int argc, char *argv[], char *env[]) {
+  int ret;
+  pthread_t th[T];
+
+  for (int i = 0; i < T; ++i) {
+    ret = pthread_create(&th[i], NULL, thread_func, NULL);
+    assert(!ret && "pthread_create() failed!");
+  }
+  thread_func(NULL);
+  for (int i = 0; i < T; ++i) {
+    ret = pthread_join(th[i], NULL);
+    assert(!ret && "pthread_join() failed!");
+  }
+  printf("total %d bad %d\n", total, nbad);
+  return 0;
+}
+
+// CHECK: total 600 bad 0
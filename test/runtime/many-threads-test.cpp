@@ -0,0 +1,60 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// RUN: %srcroot/test/runtime/run-scheduler-test.py %s -gxx "%gxx" -llvmgcc "%llvmgcc" -projbindir "%projbindir" -ternruntime "%ternruntime" -ternannotlib "%ternannotlib"  -ternbcruntime "%ternbcruntime"
+
+/* Creates more threads over the life of the program than the scheduler
+   used to have static per-thread slots for (5000). The tids of joined
+   threads are recycled, so only about N tids are ever in use. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <assert.h>
+#include <stdint.h>
+
+#define ROUNDS (60)
+#define N (100)
+
+pthread_mutex_t m = PTHREAD_MUTEX_INITIALIZER;
+int count = 0;
+
+void* thread_func(void *arg) {
+  pthread_mutex_lock(&m);
+  count++;
+  pthread_mutex_unlock(&m);
+  return NULL;
+}
+
+int main(int argc, char *argv[], char *env[]) {
+  int ret;
+  pthread_t th[N];
+
+  for(unsigned r=0; r<ROUNDS; ++r) {
+    for(unsigned i=0; i<N; ++i) {
+      ret  = pthread_create(&th[i], NULL, thread_func, (void*)(intptr_t)i);
+      assert(!ret && "pthread_create() failed!");
+    }
+    for(unsigned i=0; i<N; ++i)
+      pthread_join(th[i], NULL);
+  }
+  printf("%d threads ran\n", count);
+  return 0;
+}
+
+// CHECK: 6000 threads ran
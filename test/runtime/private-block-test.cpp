@@ -0,0 +1,68 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+// RUN: %srcroot/test/runtime/run-scheduler-test.py %s -gxx "%gxx" -llvmgcc "%llvmgcc" -projbindir "%projbindir" -ternruntime "%ternruntime" -ternannotlib "%ternannotlib"  -ternbcruntime "%ternbcruntime" -nondet
+
+// Main blocks in read() on a pipe while holding no lock, but owning a
+// mutex only it has used so far; the child needs that mutex before it
+// writes the byte main waits for. With private_sync_fast_path, main
+// must share the mutex before it blocks, or the child waits for main's
+// next turn forever.
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+
+pthread_mutex_t mu = PTHREAD_MUTEX_INITIALIZER;
+int fds[2];
+int flag = 0;
+
+void* thread_func(void*) {
+  pthread_mutex_lock(&mu);
+  flag = 1;
+  pthread_mutex_unlock(&mu);
+  char c = 'x';
+  assert(write(fds[1], &c, 1) == 1);
+  return NULL;
+}
+
+int main(int argc, char *argv[], char *env[]) {
+  int ret;
+  pthread_t th;
+
+  ret = pipe(fds);
+  assert(!ret && "pipe() failed!");
+  pthread_mutex_lock(&mu);
+  pthread_mutex_unlock(&mu);
+
+  ret = pthread_create(&th, NULL, thread_func, NULL);
+  assert(!ret && "pthread_create() failed!");
+
+  char c;
+  ret = read(fds[0], &c, 1);
+  assert(ret == 1 && "read() failed!");
+
+  ret = pthread_join(th, NULL);
+  assert(!ret && "pthread_join() failed!");
+  pthread_mutex_lock(&mu);
+  printf("flag %d\n", flag);
+  pthread_mutex_unlock(&mu);
+  return 0;
+}
+
+// CHECK: flag 1
@@ -0,0 +1,78 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+// RUN: %srcroot/test/runtime/run-scheduler-test.py %s -gxx "%gxx" -llvmgcc "%llvmgcc" -projbindir "%projbindir" -ternruntime "%ternruntime" -ternannotlib "%ternannotlib"  -ternbcruntime "%ternbcruntime"
+
+// Each mutex is first used by one thread only, then by a second one. With
+// private_sync_fast_path, @m2 is requested while its owner (the child) may
+// still be running and becomes shared at the owner's next turn; @m1 is
+// taken over at once because its owner (main) waits for a turn. Either way
+// no update may be lost.
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+
+#define N 1000
+
+pthread_mutex_t m1 = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t m2 = PTHREAD_MUTEX_INITIALIZER;
+int x = 0, y = 0;
+
+void* thread_func(void*) {
+  for (int i = 0; i < N; ++i) {
+    pthread_mutex_lock(&m2);
+    ++y;
+    pthread_mutex_unlock(&m2);
+  }
+  pthread_mutex_lock(&m2);
+  printf("child y %d\n", y);
+  pthread_mutex_unlock(&m2);
+
+  pthread_mutex_lock(&m1);
+  ++x;
+  pthread_mutex_unlock(&m1);
+  return NULL;
+}
+
+int main(int argc, char *argv[], char *env[]) {
+  int ret;
+  pthread_t th;
+
+  for (int i = 0; i < N; ++i) {
+    pthread_mutex_lock(&m1);
+    ++x;
+    pthread_mutex_unlock(&m1);
+  }
+
+  ret = pthread_create(&th, NULL, thread_func, NULL);
+  assert(!ret && "pthread_create() failed!");
+  sched_yield(); // let the child touch @m2 first
+
+  pthread_mutex_lock(&m2);
+  ++y;
+  printf("main y %d\n", y);
+  pthread_mutex_unlock(&m2);
+
+  ret = pthread_join(th, NULL);
+  assert(!ret && "pthread_join() failed!");
+  printf("x %d y %d\n", x, y);
+  return 0;
+}
+
+// CHECK: x 1001 y 1001
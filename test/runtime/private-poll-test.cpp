@@ -0,0 +1,62 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+// RUN: %srcroot/test/runtime/run-scheduler-test.py %s -gxx "%gxx" -llvmgcc "%llvmgcc" -projbindir "%projbindir" -ternruntime "%ternruntime" -ternannotlib "%ternannotlib"  -ternbcruntime "%ternbcruntime"
+
+// Main polls a flag under a mutex that only it has used so far, and the
+// child sets the flag under the same mutex. With private_sync_fast_path,
+// main's polling takes no turn, so the child can only get the mutex if
+// main still takes one now and then (private_sync_turn_ops).
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+
+pthread_mutex_t mu = PTHREAD_MUTEX_INITIALIZER;
+int flag = 0;
+
+void* thread_func(void*) {
+  pthread_mutex_lock(&mu);
+  flag = 1;
+  pthread_mutex_unlock(&mu);
+  return NULL;
+}
+
+int main(int argc, char *argv[], char *env[]) {
+  int ret;
+  pthread_t th;
+
+  pthread_mutex_lock(&mu);
+  pthread_mutex_unlock(&mu);
+
+  ret = pthread_create(&th, NULL, thread_func, NULL);
+  assert(!ret && "pthread_create() failed!");
+
+  int done = 0;
+  while (!done) {
+    pthread_mutex_lock(&mu);
+    done = flag;
+    pthread_mutex_unlock(&mu);
+  }
+
+  ret = pthread_join(th, NULL);
+  assert(!ret && "pthread_join() failed!");
+  printf("done\n");
+  return 0;
+}
+
+// CHECK: done
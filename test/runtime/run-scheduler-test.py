@@ -220,6 +220,52 @@ cmds = '''
 // test RR scheduler
 // RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:nanosec_per_turn=100000:enforce_turn_type=1:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 | FileCheck %s
 // RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:nanosec_per_turn=100000:enforce_turn_type=1:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 ScheduleCheck
+
+// test RR scheduler with the futex turn relay
+// RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=4:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 | FileCheck %s
+// RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=4:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 ScheduleCheck
+
+// test RR scheduler with token recovery instead of the idle thread
+// RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=4:launch_idle_thread=0:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 | FileCheck %s
+// RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=4:launch_idle_thread=0:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 ScheduleCheck
+
+// test RR scheduler with the runtime-owned mutex, rwlock, barrier and semaphore engines
+// RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=4:mutex_engine=1:rwlock_engine=1:barrier_engine=1:sem_engine=1:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 | FileCheck %s
+// RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=4:mutex_engine=1:rwlock_engine=1:barrier_engine=1:sem_engine=1:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 ScheduleCheck
+
+// test RR scheduler with turn-free thread-private mutexes
+// RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=4:private_sync_fast_path=1:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 | FileCheck %s
+// RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=4:private_sync_fast_path=1:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 ScheduleCheck
+
+// test RR scheduler with turn-free init/destroy on top of private mutexes and the engines
+// RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=4:turn_free_init=1:private_sync_fast_path=1:mutex_engine=1:rwlock_engine=1:sem_engine=1:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 | FileCheck %s
+// RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=4:turn_free_init=1:private_sync_fast_path=1:mutex_engine=1:rwlock_engine=1:sem_engine=1:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 ScheduleCheck
+
+// test RR scheduler with the turn kept by a lone runnable thread
+// RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=4:solo_fast_path=1:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 | FileCheck %s
+// RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=4:solo_fast_path=1:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 ScheduleCheck
+
+// test RR scheduler with the next threads on runq woken up ahead of their turn
+// RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=4:prewake_depth=2:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 | FileCheck %s
+// RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=4:prewake_depth=2:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 ScheduleCheck
+
+// test RR scheduler with a turn quantum; it changes the interleaving, and so
+// the expected output of schedule-dependent tests, so only determinism is checked
+// RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=4:turn_quantum=8:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 ScheduleCheck
+
+// test sharded turns; like the turn quantum, they change the interleaving
+// RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=4:turn_shards=4:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 ScheduleCheck
+
+// test scheduling domains, placed by creation order and inherited by the rest
+// RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=4:turn_domains=3:thread_domains=0,1,2,-,1:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 ScheduleCheck
+
+// test the logical clock scheduler
+// RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=4:clock_scheduler=1:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 ScheduleCheck
+
+// test back-edge preemption (see backedge-spin-test.cpp); a thread spinning on a
+// flag preempts itself a number of times that depends on timing, so only the
+// output is checked
+// RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=4:backedge_preempt=1000:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 | FileCheck %s
 '''
 
 if os.getenv('test_dync_only') != None :
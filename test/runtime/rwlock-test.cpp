@@ -0,0 +1,102 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+// RUN: %srcroot/test/runtime/run-scheduler-test.py %s -gxx "%gxx" -llvmgcc "%llvmgcc" -projbindir "%projbindir" -ternruntime "%ternruntime" -ternannotlib "%ternannotlib"  -ternbcruntime "%ternbcruntime"
+
+// Readers queued behind a writer all get in once it unlocks (one batch
+// with rwlock_engine), and a timed write lock gives up while a reader
+// holds the lock.
+
+#include <sys/time.h>
+#include <time.h>
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include "tern/user.h"
+
+#define N 3
+
+pthread_rwlock_t rw = PTHREAD_RWLOCK_INITIALIZER;
+int data = 0;
+int seen[N];
+
+void* reader(void *arg) {
+  pthread_rwlock_rdlock(&rw);
+  seen[(long)arg] = data; // readers run in parallel, so don't print here
+  pthread_rwlock_unlock(&rw);
+  return NULL;
+}
+
+void* timed_writer(void*) {
+  int ret;
+  struct timespec ts;
+  struct timeval now;
+
+  gettimeofday(&now, NULL);
+  ts.tv_sec = now.tv_sec;
+  ts.tv_nsec = now.tv_usec * 1000 + 100000000;
+  if (ts.tv_nsec >= 1000000000) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000;
+  }
+  tern_set_base_timeval(&now);
+  ret = pthread_rwlock_timedwrlock(&rw, &ts);
+  assert(ret == ETIMEDOUT);
+  printf("timedwrlock timed out\n");
+  return NULL;
+}
+
+int main(int argc, char *argv[], char *env[]) {
+  int ret;
+  pthread_t th[N], tw;
+
+  pthread_rwlock_wrlock(&rw);
+  for (long i = 0; i < N; ++i) {
+    ret = pthread_create(&th[i], NULL, reader, (void*)i);
+    assert(!ret && "pthread_create() failed!");
+  }
+  for (int i = 0; i < N; ++i)
+    sched_yield(); // let the readers queue up
+  data = 42;
+  pthread_rwlock_unlock(&rw);
+  for (int i = 0; i < N; ++i) {
+    pthread_join(th[i], NULL);
+    printf("reader %d sees %d\n", i, seen[i]);
+  }
+
+  pthread_rwlock_rdlock(&rw);
+  ret = pthread_rwlock_trywrlock(&rw);
+  assert(ret == EBUSY);
+  ret = pthread_create(&tw, NULL, timed_writer, NULL);
+  assert(!ret && "pthread_create() failed!");
+  pthread_join(tw, NULL);
+  pthread_rwlock_unlock(&rw);
+
+  ret = pthread_rwlock_trywrlock(&rw);
+  assert(ret == 0);
+  pthread_rwlock_unlock(&rw);
+  printf("done\n");
+  return 0;
+}
+
+// CHECK: reader 0 sees 42
+// CHECK: reader 1 sees 42
+// CHECK: reader 2 sees 42
+// CHECK: timedwrlock timed out
+// CHECK: done
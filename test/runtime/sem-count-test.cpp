@@ -0,0 +1,96 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+// RUN: %srcroot/test/runtime/run-scheduler-test.py %s -gxx "%gxx" -llvmgcc "%llvmgcc" -projbindir "%projbindir" -ternruntime "%ternruntime" -ternannotlib "%ternannotlib"  -ternbcruntime "%ternbcruntime"
+
+// Producer/consumer on a counting semaphore: every posted unit is taken
+// exactly once, sem_trywait and sem_timedwait fail on an empty semaphore,
+// and sem_getvalue reports the count.
+
+#include <sys/time.h>
+#include <time.h>
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include "tern/user.h"
+
+#define N 3
+#define ITEMS 100
+
+sem_t items;
+int taken[N];
+
+void* consumer(void *arg) {
+  for (int i = 0; i < ITEMS; ++i) {
+    sem_wait(&items);
+    taken[(long)arg]++;
+  }
+  return NULL;
+}
+
+int main(int argc, char *argv[], char *env[]) {
+  int ret, value;
+  pthread_t th[N];
+
+  sem_init(&items, 0, 2);
+  sem_getvalue(&items, &value);
+  printf("initial value %d\n", value);
+
+  for (long i = 0; i < N; ++i) {
+    ret = pthread_create(&th[i], NULL, consumer, (void*)i);
+    assert(!ret && "pthread_create() failed!");
+  }
+  for (int i = 0; i < N * ITEMS - 2; ++i)
+    sem_post(&items);
+  int total = 0;
+  for (int i = 0; i < N; ++i) {
+    pthread_join(th[i], NULL);
+    total += taken[i];
+  }
+  sem_getvalue(&items, &value);
+  printf("taken %d, value %d\n", total, value);
+
+  ret = sem_trywait(&items);
+  printf("trywait %d %d\n", ret, ret ? errno == EAGAIN : 0);
+
+  struct timespec ts;
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  ts.tv_sec = now.tv_sec;
+  ts.tv_nsec = now.tv_usec * 1000 + 100000000;
+  if (ts.tv_nsec >= 1000000000) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000;
+  }
+  tern_set_base_timeval(&now);
+  ret = sem_timedwait(&items, &ts);
+  printf("timedwait %d %d\n", ret, ret ? errno == ETIMEDOUT : 0);
+
+  sem_post(&items);
+  ret = sem_trywait(&items);
+  printf("trywait %d\n", ret);
+  sem_destroy(&items);
+  return 0;
+}
+
+// CHECK:      initial value 2
+// CHECK-NEXT: taken 300, value 0
+// CHECK-NEXT: trywait -1 1
+// CHECK-NEXT: timedwait -1 1
+// CHECK-NEXT: trywait 0
@@ -0,0 +1,146 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// RUN: %srcroot/test/runtime/run-scheduler-test.py %s -gxx "%gxx" -llvmgcc "%llvmgcc" -projbindir "%projbindir" -ternruntime "%ternruntime" -ternannotlib "%ternannotlib"  -ternbcruntime "%ternbcruntime"
+
+/* A simple test file for the per-channel wait queues. */
+
+#include "../../include/tern/runtime/wait-queue.h"
+
+using namespace std;
+using namespace tern;
+run_queue q;
+wait_queue wq;
+int chan_a, chan_b, chan_c;
+
+void print() {
+  int i = 0;
+  printf("q size %u, wq size %u\n", (unsigned)q.size(), (unsigned)wq.size());
+  for (run_queue::iterator itr = q.begin(); itr != q.end(); itr++) {
+    printf("q[%d] = %d\n", i, *itr);
+    i++;
+  }
+}
+
+void block(int tid, void *chan, unsigned timeout) {
+  wq.push_back(q.get_my_elem(tid), chan, timeout);
+}
+
+int main(int argc, char *argv[]) {
+  for (int tid = 2; tid <= 7; tid++)
+    q.create_thd_elem(tid);
+  q.push_back(2);
+
+  block(3, &chan_a, wait_queue::NO_TIMEOUT);
+  block(4, &chan_b, 10);
+  block(5, &chan_a, 20);
+  block(6, &chan_a, wait_queue::NO_TIMEOUT);
+  block(7, &chan_b, wait_queue::NO_TIMEOUT);
+  print();
+
+  // signal wakes up the first waiter on the channel only
+  q.push_back(wq.pop_front(&chan_b)->tid);
+  print();
+
+  // a signal with no waiter is a no-op
+  printf("no waiter %d\n", wq.pop_front(&chan_c) == NULL);
+
+  // a timed out waiter leaves its channel
+  std::vector<run_queue::runq_elem*> expired;
+  printf("next timeout %u\n", wq.next_timeout());
+  printf("expired %u\n", (unsigned)wq.pop_expired(20, expired));
+  printf("expired %u\n", (unsigned)wq.pop_expired(21, expired));
+  printf("timed out %d\n", expired[0]->tid);
+  printf("next timeout %d\n", wq.next_timeout() == wait_queue::NO_TIMEOUT);
+
+  // broadcast moves the remaining waiters in FIFO order
+  printf("broadcast %u\n", (unsigned)wq.pop_all(&chan_a, q));
+  print();
+  printf("has waiters %d %d\n", wq.has_waiters(&chan_a), wq.has_waiters(&chan_b));
+
+  block(5, &chan_a, wait_queue::NO_TIMEOUT);
+  q.pop_front();
+  block(2, &chan_a, wait_queue::NO_TIMEOUT);
+  printf("broadcast %u\n", (unsigned)wq.pop_all(&chan_a, q));
+  print();
+
+  // a list kept by its owner works without a channel lookup
+  wait_queue::list_t l;
+  q.pop_front();
+  wq.push_back(q.get_my_elem(4), l);
+  q.pop_front();
+  wq.push_back(q.get_my_elem(3), l);
+  printf("list waiters %u, wq size %u\n", (unsigned)l.num_waiters, (unsigned)wq.size());
+  printf("list broadcast %u\n", (unsigned)wq.pop_all(l, q));
+  print();
+  printf("list broadcast %u\n", (unsigned)wq.pop_all(l, q));
+
+  // channel records go with their last waiter (7 still waits on chan_b);
+  // the others keep their address while the table grows and shrinks
+  sync_table &objs = wq.objects();
+  printf("objs %u\n", (unsigned)objs.size());
+  static int vars[200];
+  sync_obj_t *first = objs.find_or_create(&vars[0]);
+  first->kind = sync_obj_t::MUTEX;
+  for (int i = 1; i < 200; i++)
+    objs.find_or_create(&vars[i])->kind = sync_obj_t::MUTEX;
+  for (int i = 1; i < 200; i += 2)
+    objs.erase(objs.find(&vars[i]));
+  int nfound = 0;
+  for (int i = 0; i < 200; i++)
+    nfound += objs.find(&vars[i]) != NULL;
+  printf("objs %u, found %d, stable %d\n", (unsigned)objs.size(), nfound,
+         objs.find_or_create(&vars[0]) == first);
+}
+
+// CHECK: q size 1, wq size 5
+// CHECK-NEXT: q[0] = 2
+// CHECK-NEXT: q size 2, wq size 4
+// CHECK-NEXT: q[0] = 2
+// CHECK-NEXT: q[1] = 4
+// CHECK-NEXT: no waiter 1
+// CHECK-NEXT: next timeout 20
+// CHECK-NEXT: expired 0
+// CHECK-NEXT: expired 1
+// CHECK-NEXT: timed out 5
+// CHECK-NEXT: next timeout 1
+// CHECK-NEXT: broadcast 2
+// CHECK-NEXT: q size 4, wq size 1
+// CHECK-NEXT: q[0] = 2
+// CHECK-NEXT: q[1] = 4
+// CHECK-NEXT: q[2] = 3
+// CHECK-NEXT: q[3] = 6
+// CHECK-NEXT: has waiters 0 1
+// CHECK-NEXT: broadcast 2
+// CHECK-NEXT: q size 5, wq size 1
+// CHECK-NEXT: q[0] = 4
+// CHECK-NEXT: q[1] = 3
+// CHECK-NEXT: q[2] = 6
+// CHECK-NEXT: q[3] = 5
+// CHECK-NEXT: q[4] = 2
+// CHECK-NEXT: list waiters 2, wq size 3
+// CHECK-NEXT: list broadcast 2
+// CHECK-NEXT: q size 5, wq size 1
+// CHECK-NEXT: q[0] = 6
+// CHECK-NEXT: q[1] = 5
+// CHECK-NEXT: q[2] = 2
+// CHECK-NEXT: q[3] = 4
+// CHECK-NEXT: q[4] = 3
+// CHECK-NEXT: list broadcast 0
+// CHECK-NEXT: objs 1
+// CHECK-NEXT: objs 101, found 100, stable 1